@@ -6,8 +6,10 @@
 #include "move.h"
 #include "movegen.h"
 #include "nnue.h"
+#include "numa.h"
 #include "search.h"
 #include "searcher.h"
+#include "tablebase.h"
 #include "types.h"
 
 #ifndef EVALFILE
@@ -31,7 +33,8 @@ static_assert(false && "EVALFILE must be defined for network embedding or loadin
 INCBIN(EVAL, EVALFILE);
 #endif
 
-NNUE nnue;
+NetworkSlot nnue;
+NetworkSlot smallNnue;
 bool chess960          = false;
 bool nodesAreSoftNodes = false;
 
@@ -39,17 +42,20 @@ bool nodesAreSoftNodes = false;
 int main(const int argc, char* argv[]) {
     Movegen::initializeAllDatabases();
 
-    auto loadDefaultNet = [&]([[maybe_unused]] bool warnMSVC = false) {
+    const auto loadDefaultNet = [](Network& network, [[maybe_unused]] bool warnMSVC = false) {
 #if defined(_MSC_VER) && !defined(__clang__) && defined(EVALFILE)
-        nnue.loadNetwork(EVALFILE);
         if (warnMSVC)
             cerr << "WARNING: This file was compiled with MSVC, this means that an nnue was NOT embedded into the exe." << endl;
+        return network.loadFile(EVALFILE);
 #else
-        nnue = *reinterpret_cast<const NNUE*>(gEVALData);
+        return network.loadMemory(reinterpret_cast<const u8*>(gEVALData), gEVALSize);
 #endif
     };
 
-    loadDefaultNet(true);
+    if (!nnue.load([&](Network& network) { return loadDefaultNet(network, true); })) {
+        cerr << "The default network could not be loaded" << endl;
+        return 1;
+    }
 
     Board  board;
     string command;
@@ -82,8 +88,38 @@ int main(const int argc, char* argv[]) {
         for (int i = 0; i < argc; i++)
             args[i] = argv[i];
 
-        if (args[1] == "bench")
-            bench();
+        if (args[1] == "bench") {
+            // Tables are optional so bench can also measure probe cost
+            const auto syzygy = findIndexOf(args, "--syzygy");
+            if (syzygy >= 0 && syzygy + 1 < static_cast<int>(args.size()))
+                Tablebase::init(args[syzygy + 1]);
+            const auto threads = findIndexOf(args, "--threads");
+            DETERMINISTIC_SMP  = findIndexOf(args, "--deterministic") >= 0;
+            bench(threads >= 0 && threads + 1 < static_cast<int>(args.size()) ? std::stoull(args[threads + 1]) : 1);
+        }
+        else if (args[1] == "ttd")
+            timeToDepth(args.size() > 2 ? std::stoull(args[2]) : 32, args.size() > 3 ? std::stoull(args[3]) : 12);
+        else if (args[1] == "evalbench")
+            evalBench();
+        else if (args[1] == "evalbatch") {
+            if (args.size() < 4) {
+                cout << "Usage: evalbatch <input> <output> [--threads N]" << endl;
+                return 1;
+            }
+            const auto threads = findIndexOf(args, "--threads");
+            if (!evalBatch(args[2], args[3], threads >= 0 && threads + 1 < static_cast<int>(args.size()) ? std::stoull(args[threads + 1]) : 1))
+                return 1;
+        }
+        else if (args[1] == "convertnet") {
+            if (args.size() < 4) {
+                cout << "Usage: convertnet <input> <output>" << endl;
+                return 1;
+            }
+            Network network;
+            if (!network.loadFile(args[2]) || !network.save(args[3]))
+                return 1;
+            cout << "Saved network to " << args[3] << endl;
+        }
         else if (args[1] == "tune-config") {
 #ifdef TUNE
             printTuneOB();
@@ -114,7 +150,20 @@ int main(const int argc, char* argv[]) {
             cout << "option name Threads type spin default 1 min 1 max 2048" << endl;
             cout << "option name Hash type spin default 16 min 1 max 524288" << endl;
             cout << "option name Move Overhead type spin default 20 min 0 max 1000" << endl;
+            cout << "option name nodestime type spin default 0 min 0 max 10000" << endl;
+            cout << "option name LMRPerturbation type check default false" << endl;
+            cout << "option name DeterministicSMP type check default false" << endl;
+            cout << "option name ABDADA type check default false" << endl;
+            cout << "option name NumaPolicy type combo default auto var none var auto var nosmt" << endl;
+            cout << "option name MultiPV type spin default 1 min 1 max 256" << endl;
+            cout << "option name EvalCache type spin default 256 min 0 max 65536" << endl;
+            cout << "option name Ponder type check default false" << endl;
             cout << "option name EvalFile type string default internal" << endl;
+            cout << "option name SmallEvalFile type string default <empty>" << endl;
+            cout << "option name SyzygyPath type string default <empty>" << endl;
+            cout << "option name SyzygyProbeDepth type spin default 1 min 1 max 100" << endl;
+            cout << "option name SyzygyProbeLimit type spin default 7 min 0 max 7" << endl;
+            cout << "option name SyzygyProbesPerDepth type spin default 0 min 0 max 1000000000" << endl;
             cout << "option name UCI_Chess960 type check default false" << endl;
             cout << "option name Softnodes type check default false" << endl;
 #ifdef TUNE
@@ -128,8 +177,12 @@ int main(const int argc, char* argv[]) {
         }
         else if (command == "ucinewgame")
             searcher.reset();
-        else if (command == "isready")
+        else if (command == "isready") {
+            // Networks load in the background, so the engine is only ready once the last one is in place
+            nnue.waitForLoad();
+            smallNnue.waitForLoad();
             cout << "readyok" << endl;
+        }
         else if (tokens[0] == "position") {
             if (tokens[1] == "startpos") {
                 board.reset();
@@ -161,14 +214,28 @@ int main(const int argc, char* argv[]) {
             const usize winc = std::stoi(getValueFollowing(command, "winc", 0));
             const usize binc = std::stoi(getValueFollowing(command, "binc", 0));
 
+            const usize movesToGo = std::stoi(getValueFollowing(command, "movestogo", 0));
+
             const usize mate = std::stoi(getValueFollowing(command, "mate", 0));
 
+            const bool ponder = findIndexOf(tokens, "ponder") >= 0;
+
             if (nodesAreSoftNodes && maxNodes) {
                 softNodes = maxNodes;
                 maxNodes  = 0;
             }
 
-            searcher.start(board, SearchParams(commandTime, depth, maxNodes, softNodes, mtime, wtime, btime, winc, binc, mate));
+            SearchParams params(commandTime, depth, maxNodes, softNodes, mtime, wtime, btime, winc, binc, movesToGo, mate);
+
+            // searchmoves takes every following token until the next go parameter
+            const int searchMovesIndex = findIndexOf(tokens, "searchmoves");
+            if (searchMovesIndex >= 0) {
+                const std::array<string, 12> goParams = { "ponder", "wtime", "btime", "winc", "binc", "movestogo", "depth", "nodes", "softnodes", "mate", "movetime", "infinite" };
+                for (usize i = searchMovesIndex + 1; i < tokens.size() && std::ranges::find(goParams, tokens[i]) == goParams.end(); i++)
+                    params.searchMoves.add(Move(tokens[i], board));
+            }
+
+            searcher.start(board, params, ponder);
         }
         else if (tokens[0] == "setoption") {
             if (tokens[2] == "Threads")
@@ -177,12 +244,52 @@ int main(const int argc, char* argv[]) {
                 searcher.resizeTT(std::stoull(getValueFollowing(command, "value", 16)));
             else if (tokens[2] == "Move" && tokens[3] == "Overhead")
                 MOVE_OVERHEAD = std::stoi(tokens[findIndexOf(tokens, "value") + 1]);
+            else if (tokens[2] == "nodestime")
+                NODES_TIME = std::stoull(getValueFollowing(command, "value", 0));
+            else if (tokens[2] == "LMRPerturbation")
+                SMP_LMR_PERTURBATION = tokens[findIndexOf(tokens, "value") + 1] == "true";
+            else if (tokens[2] == "DeterministicSMP")
+                DETERMINISTIC_SMP = tokens[findIndexOf(tokens, "value") + 1] == "true";
+            else if (tokens[2] == "ABDADA")
+                ABDADA = tokens[findIndexOf(tokens, "value") + 1] == "true";
+            else if (tokens[2] == "NumaPolicy") {
+                // Thread data is rebuilt so it is allocated on the nodes the threads now run on
+                if (Numa::setPolicy(tokens[findIndexOf(tokens, "value") + 1]))
+                    searcher.setThreads(searcher.threadData.size());
+                cout << "info string " << Numa::nodeCount() << " NUMA nodes, threads " << (Numa::active(searcher.threadData.size()) ? "bound" : "not bound") << endl;
+            }
+            else if (tokens[2] == "MultiPV")
+                MULTI_PV = std::stoull(getValueFollowing(command, "value", 1));
+            else if (tokens[2] == "EvalCache")
+                searcher.resizeEvalCache(std::stoull(getValueFollowing(command, "value", 256)));
             else if (tokens[2] == "EvalFile") {
                 const string value = tokens[findIndexOf(tokens, "value") + 1];
-                if (value == "internal")
-                    loadDefaultNet();
+                nnue.loadAsync([=](Network& network) { return value == "internal" ? loadDefaultNet(network) : network.loadFile(value); });
+            }
+            else if (tokens[2] == "SmallEvalFile") {
+                const usize valueIndex = findIndexOf(tokens, "value") + 1;
+                if (valueIndex >= tokens.size() || tokens[valueIndex] == "<empty>")
+                    smallNnue.clear();
                 else
-                    nnue.loadNetwork(value);
+                    smallNnue.loadAsync([value = tokens[valueIndex]](Network& network) { return network.loadFile(value); });
+            }
+            else if (tokens[2] == "SyzygyPath") {
+                // Paths may contain spaces, so everything after value is the path
+                const usize  valueIndex = findIndexOf(tokens, "value") + 1;
+                const string path       = valueIndex < tokens.size() ? command.substr(command.find(" value ") + 7) : "<empty>";
+
+                const usize pieces = Tablebase::init(path);
+                if (pieces > 0)
+                    cout << "info string Found " << pieces << " piece tablebases" << endl;
+            }
+            else if (tokens[2] == "SyzygyProbeDepth")
+                SYZYGY_PROBE_DEPTH = std::stoull(getValueFollowing(command, "value", 1));
+            else if (tokens[2] == "SyzygyProbeLimit")
+                SYZYGY_PROBE_LIMIT = std::stoull(getValueFollowing(command, "value", 7));
+            else if (tokens[2] == "SyzygyProbesPerDepth")
+                SYZYGY_PROBES_PER_DEPTH = std::stoull(getValueFollowing(command, "value", 0));
+            else if (tokens[2] == "Ponder") {
+                // Only tells the GUI pondering is supported, each go ponder starts its own ponder search
             }
             else if (tokens[2] == "UCI_Chess960")
                 chess960 = tokens[findIndexOf(tokens, "value") + 1] == "true";
@@ -195,6 +302,8 @@ int main(const int argc, char* argv[]) {
         }
         else if (command == "stop")
             searcher.stop();
+        else if (command == "ponderhit")
+            searcher.ponderhit();
         else if (command == "wait")
             searcher.waitUntilFinished();
         else if (command == "quit") {
@@ -228,10 +337,19 @@ int main(const int argc, char* argv[]) {
         }
         else if (tokens[0] == "perftsuite")
             Movegen::perftSuite(tokens[1]);
+        else if (command == "tbwarmup") {
+            Stopwatch<std::chrono::milliseconds> warmupTime;
+            const u64                            bytes = Tablebase::warmup();
+            cout << "info string Warmed " << bytes / (1024 * 1024) << " MiB of WDL tables in " << warmupTime.elapsed() << " ms" << endl;
+        }
         else if (command == "eval") {
-            searcher.threadData[0].refresh(board);
-            cout << "Raw eval: " << nnue.forwardPass(&board, searcher.threadData[0].accumulatorStack.top()) << endl;
-            nnue.showBuckets(&board, searcher.threadData[0].accumulatorStack.top());
+            nnue.waitForLoad();
+            // Evaluated on its own accumulators, a running search keeps the network and stacks it started with
+            const std::shared_ptr<const Network> network = nnue.get();
+            OwnedAccumulatorPair<MAX_HL_SIZE>    accumulators;
+            (*network)->refresh(board, accumulators);
+            cout << "Raw eval: " << (*network)->forwardPass(&board, accumulators) << endl;
+            (*network)->showBuckets(&board, accumulators);
         }
         else if (command == "moves") {
             for (Move m : Movegen::generateMoves<ALL_MOVES>(board)) {
@@ -4,19 +4,172 @@
 #include "move.h"
 #include "types.h"
 
-using Accumulator = array<i16, HL_SIZE>;
+#include <algorithm>
+#include <memory>
 
+// One perspective's hidden layer values, the storage belongs to an AccumulatorStack block or an OwnedAccumulatorPair
+// Values are 64 byte aligned and only the first HL are used by a network with a hidden layer of size HL
+struct Accumulator {
+    i16* values = nullptr;
+
+    i16& operator[](const usize i) const {
+        return values[i];
+    }
+    i16* data() const {
+        return values;
+    }
+    i16* begin() const {
+        return values;
+    }
+};
+
+// Features a move adds and removes, indexed [perspective][i]
+struct AccumulatorUpdate {
+    MultiArray<u16, 2, 2> adds;
+    MultiArray<u16, 2, 2> subs;
+    u8                    addCount = 0;
+    u8                    subCount = 0;
+
+    void add(Color color, PieceType pt, Square sq);
+    void sub(Color color, PieceType pt, Square sq);
+
+    // Board is the position before the move, so the update is known before the move is made
+    static AccumulatorUpdate fromMove(const Board& board, Move m);
+
+    // Start loading the weight rows the update will read
+    template<usize HL>
+    void prefetch(const i16* weightsToHL) const;
+};
+
+// Children hold the update from their parent and only write their values once they are needed
+// Copies would share the values, so pairs are never copied
 struct AccumulatorPair {
-    alignas(64) Accumulator white_;
-    alignas(64) Accumulator black_;
+    Accumulator white_;
+    Accumulator black_;
+
+    // Set while white_ and black_ are stale and still need pending applied to the parent
+    bool              dirty = false;
+    AccumulatorUpdate pending;
+
+    AccumulatorPair()                                  = default;
+    AccumulatorPair(const AccumulatorPair&)            = delete;
+    AccumulatorPair& operator=(const AccumulatorPair&) = delete;
+
+    template<usize HL>
+    void resetAccumulators(const Board& board, const i16* weightsToHL, const i16* bias);
+    // Refresh up to EVAL_BATCH_SIZE positions, each weight row is read once for every accumulator that adds it
+    template<usize HL>
+    static void resetAccumulators(const Board* const* boards, AccumulatorPair* const* accumulators, usize count, const i16* weightsToHL, const i16* bias);
+
+    // Apply the pending update to the parent
+    template<usize HL>
+    void apply(const AccumulatorPair& parent, const i16* weightsToHL);
+
+    template<usize HL, usize ADDS, usize SUBS>
+    void addSub(const AccumulatorPair& parent, const i16* weightsToHL);
+
+    bool equals(const AccumulatorPair& other, usize hlSize) const;
+};
+
+// Pair with its own values, for evaluations outside the search's stacks
+template<usize HL>
+struct OwnedAccumulatorPair : AccumulatorPair {
+    alignas(64) array<i16, HL> whiteValues;
+    alignas(64) array<i16, HL> blackValues;
+
+    OwnedAccumulatorPair() {
+        white_.values = whiteValues.data();
+        black_.values = blackValues.data();
+    }
+};
+
+// Accumulators for each ply of a search, allocated in aligned blocks the first time a ply reaches them
+// Blocks never move, so references to earlier plies stay valid while the stack grows
+// Values are sized for the hidden layer of the network the stack serves
+class AccumulatorStack {
+    static constexpr usize BLOCK_SIZE = 16;
+    static constexpr usize MAX_SIZE   = MAX_PLY + 1;
+
+    // Unit of allocation, every accumulator starts on its own cache line
+    struct alignas(64) Chunk {
+        array<i16, 32> values;
+    };
+
+    struct Block {
+        array<AccumulatorPair, BLOCK_SIZE> pairs;
+        std::unique_ptr<Chunk[]>           chunks;
+
+        explicit Block(const usize hlSize) :
+            chunks(std::make_unique<Chunk[]>(BLOCK_SIZE * 2 * hlSize / 32)) {
+            i16* values = chunks[0].values.data();
+            for (AccumulatorPair& pair : pairs) {
+                pair.white_.values = values;
+                pair.black_.values = values + hlSize;
+                values += hlSize * 2;
+            }
+        }
+    };
+
+    array<std::unique_ptr<Block>, (MAX_SIZE + BLOCK_SIZE - 1) / BLOCK_SIZE> blocks;
+    usize                                                                   ptr    = 0;
+    usize                                                                   hlSize = 0;
+
+    AccumulatorPair& at(const usize idx) const {
+        return blocks[idx / BLOCK_SIZE]->pairs[idx % BLOCK_SIZE];
+    }
+
+   public:
+    AccumulatorStack() = default;
+
+    AccumulatorStack(AccumulatorStack&&) noexcept            = default;
+    AccumulatorStack& operator=(AccumulatorStack&&) noexcept = default;
+    AccumulatorStack(const AccumulatorStack&)                = delete;
+    AccumulatorStack& operator=(const AccumulatorStack&)     = delete;
+
+    // Drops the blocks when the size changes, the stack is empty afterwards
+    void setHlSize(const usize size) {
+        assert(size % 32 == 0);
+        if (size != hlSize)
+            std::ranges::fill(blocks, nullptr);
+        hlSize = size;
+        ptr    = 0;
+    }
 
-    void resetAccumulators(const Board& board);
+    // Push without copying, the caller fills the new top in place
+    AccumulatorPair& push() {
+        assert(ptr < MAX_SIZE && hlSize > 0);
+        if (!blocks[ptr / BLOCK_SIZE]) [[unlikely]]
+            blocks[ptr / BLOCK_SIZE] = std::make_unique<Block>(hlSize);
+        return at(ptr++);
+    }
+    void pop() {
+        assert(ptr > 0);
+        ptr--;
+    }
+    const AccumulatorPair& top() const {
+        assert(ptr > 0);
+        return at(ptr - 1);
+    }
+    void clear() {
+        ptr = 0;
+    }
 
-    void update(const Board& board, Move m, PieceType toPT);
+    usize length() const {
+        return ptr;
+    }
+    const AccumulatorPair& operator[](const usize idx) const {
+        assert(idx < ptr);
+        return at(idx);
+    }
+    AccumulatorPair& operator[](const usize idx) {
+        assert(idx < ptr);
+        return at(idx);
+    }
 
-    void addSub(Color stm, Square add, PieceType addPT, Square sub, PieceType subPT);
-    void addSubSub(Color stm, Square add, PieceType addPT, Square sub1, PieceType subPT1, Square sub2, PieceType subPT2);
-    void addAddSubSub(Color stm, Square add1, PieceType addPT1, Square add2, PieceType addPT2, Square sub1, PieceType subPT1, Square sub2, PieceType subPT2);
+    // Plies that have memory behind them
+    usize capacity() const {
+        return std::ranges::count_if(blocks, [](const auto& block) { return block != nullptr; }) * BLOCK_SIZE;
+    }
+};
 
-    bool operator==(const AccumulatorPair& other) const = default;
-};
\ No newline at end of file
+#include "accumulator.tpp"
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "board.h"
+#include "util.h"
+
+// Finds the input feature
+inline usize inputFeature(const Color perspective, const Color color, const PieceType piece, const Square square) {
+    const usize colorIndex  = (perspective == color) ? 0 : 1;
+    const usize squareIndex = (perspective == BLACK) ? flipRank(square) : static_cast<int>(square);
+
+    return colorIndex * 64 * 6 + piece * 64 + squareIndex;
+}
+
+template<usize HL>
+void AccumulatorUpdate::prefetch(const i16* weightsToHL) const {
+    // Only the start of each row, the hardware prefetcher follows the rest once the update streams through it
+    constexpr usize LINES = std::min<usize>(4, HL * sizeof(i16) / 64);
+
+    const auto prefetchRow = [&](const usize feature) {
+        for (usize line = 0; line < LINES; line++)
+            __builtin_prefetch(&weightsToHL[feature * HL + line * 64 / sizeof(i16)]);
+    };
+
+    for (const Color perspective : { WHITE, BLACK }) {
+        for (usize i = 0; i < addCount; i++)
+            prefetchRow(adds[perspective][i]);
+        for (usize i = 0; i < subCount; i++)
+            prefetchRow(subs[perspective][i]);
+    }
+}
+
+template<usize HL>
+void AccumulatorPair::resetAccumulators(const Board& board, const i16* weightsToHL, const i16* bias) {
+    u64 whitePieces = board.pieces(WHITE);
+    u64 blackPieces = board.pieces(BLACK);
+
+    std::copy(bias, bias + HL, white_.begin());
+    std::copy(bias, bias + HL, black_.begin());
+    dirty = false;
+
+    while (whitePieces) {
+        const Square sq = popLSB(whitePieces);
+
+        const usize whiteInputFeature = inputFeature(WHITE, WHITE, board.getPiece(sq), sq);
+        const usize blackInputFeature = inputFeature(BLACK, WHITE, board.getPiece(sq), sq);
+
+        for (usize i = 0; i < HL; i++) {
+            white_[i] += weightsToHL[whiteInputFeature * HL + i];
+            black_[i] += weightsToHL[blackInputFeature * HL + i];
+        }
+    }
+
+    while (blackPieces) {
+        const Square sq = popLSB(blackPieces);
+
+        const usize whiteInputFeature = inputFeature(WHITE, BLACK, board.getPiece(sq), sq);
+        const usize blackInputFeature = inputFeature(BLACK, BLACK, board.getPiece(sq), sq);
+
+        for (usize i = 0; i < HL; i++) {
+            white_[i] += weightsToHL[whiteInputFeature * HL + i];
+            black_[i] += weightsToHL[blackInputFeature * HL + i];
+        }
+    }
+}
+
+template<usize HL>
+void AccumulatorPair::resetAccumulators(const Board* const* boards, AccumulatorPair* const* accumulators, const usize count, const i16* weightsToHL, const i16* bias) {
+    assert(count <= EVAL_BATCH_SIZE);
+
+    // Accumulators adding each feature, indexed [feature][i] and numbered position * 2 + perspective
+    MultiArray<u8, 768, EVAL_BATCH_SIZE * 2> users;
+    array<u8, 768>                           userCount{};
+
+    for (usize position = 0; position < count; position++) {
+        const Board& board = *boards[position];
+        for (const Color color : { WHITE, BLACK }) {
+            u64 pieces = board.pieces(color);
+            while (pieces) {
+                const Square sq = popLSB(pieces);
+                for (const Color perspective : { WHITE, BLACK }) {
+                    const usize feature = inputFeature(perspective, color, board.getPiece(sq), sq);
+                    users[feature][userCount[feature]++] = position * 2 + perspective;
+                }
+            }
+        }
+
+        std::copy(bias, bias + HL, accumulators[position]->white_.begin());
+        std::copy(bias, bias + HL, accumulators[position]->black_.begin());
+        accumulators[position]->dirty = false;
+    }
+
+    for (usize feature = 0; feature < 768; feature++) {
+        const i16* row = &weightsToHL[feature * HL];
+        for (usize user = 0; user < userCount[feature]; user++) {
+            AccumulatorPair&   pair        = *accumulators[users[feature][user] / 2];
+            const Accumulator& accumulator = users[feature][user] % 2 == WHITE ? pair.white_ : pair.black_;
+
+            for (usize i = 0; i < HL; i++)
+                accumulator[i] += row[i];
+        }
+    }
+}
+
+template<usize HL>
+void AccumulatorPair::apply(const AccumulatorPair& parent, const i16* weightsToHL) {
+    // Null moves have no features to change
+    if (pending.addCount == 0)
+        addSub<HL, 0, 0>(parent, weightsToHL);
+    // Quiets
+    else if (pending.addCount == 1 && pending.subCount == 1)
+        addSub<HL, 1, 1>(parent, weightsToHL);
+    // Captures
+    else if (pending.addCount == 1)
+        addSub<HL, 1, 2>(parent, weightsToHL);
+    // Castling
+    else
+        addSub<HL, 2, 2>(parent, weightsToHL);
+    dirty = false;
+}
+
+template<usize HL, usize ADDS, usize SUBS>
+void AccumulatorPair::addSub(const AccumulatorPair& parent, const i16* weightsToHL) {
+    for (const Color perspective : { WHITE, BLACK }) {
+        const Accumulator& input  = perspective == WHITE ? parent.white_ : parent.black_;
+        const Accumulator& output = perspective == WHITE ? white_ : black_;
+
+        array<const i16*, ADDS> addRows;
+        array<const i16*, SUBS> subRows;
+        for (usize i = 0; i < ADDS; i++)
+            addRows[i] = &weightsToHL[pending.adds[perspective][i] * HL];
+        for (usize i = 0; i < SUBS; i++)
+            subRows[i] = &weightsToHL[pending.subs[perspective][i] * HL];
+
+        for (usize i = 0; i < HL; i++) {
+            i16 value = input[i];
+            for (const i16* row : addRows)
+                value += row[i];
+            for (const i16* row : subRows)
+                value -= row[i];
+            output[i] = value;
+        }
+    }
+}
\ No newline at end of file
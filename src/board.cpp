@@ -310,6 +310,45 @@ u64 Board::roughKeyAfter(const Move m) const {
     return key;
 }
 
+std::pair<u64, u64> Board::correctionKeysAfter(const Move m) const {
+    u64 pawnKey  = pawnHash;
+    u64 majorKey = majorHash;
+
+    if (m.isNull())
+        return { pawnKey, majorKey };
+
+    const auto toggle = [&](const Color c, const PieceType pt, const Square sq) {
+        if (pt == PAWN)
+            pawnKey ^= PIECE_ZTABLE[c][PAWN][sq];
+        else if (pt == KING || pt == QUEEN || pt == ROOK)
+            majorKey ^= PIECE_ZTABLE[c][pt][sq];
+    };
+
+    const Square    from = m.from();
+    const Square    to   = m.to();
+    const MoveType  mt   = m.typeOf();
+    const PieceType pt   = getPiece(from);
+
+    if (mt == CASTLE) {
+        const bool isKingside = to > from;
+        toggle(stm, KING, from);
+        toggle(stm, ROOK, to);
+        toggle(stm, KING, KING_CASTLE_END_SQ[castleIndex(stm, isKingside)]);
+        toggle(stm, ROOK, ROOK_CASTLE_END_SQ[castleIndex(stm, isKingside)]);
+        return { pawnKey, majorKey };
+    }
+
+    toggle(stm, pt, from);
+    toggle(stm, mt == PROMOTION ? m.promo() : pt, to);
+
+    if (mt == EN_PASSANT)
+        toggle(~stm, PAWN, to + (stm == WHITE ? SOUTH : NORTH));
+    else if (getPiece(to) != NO_PIECE_TYPE)
+        toggle(~stm, getPiece(to), to);
+
+    return { pawnKey, majorKey };
+}
+
 // Reset the board to startpos
 void Board::reset() {
     byPieces[PAWN]   = 0xFF00ULL;
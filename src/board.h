@@ -4,6 +4,8 @@
 #include "types.h"
 #include "util.h"
 
+#include <utility>
+
 constexpr array<Square, 4> ROOK_CASTLE_END_SQ = { d8, f8, d1, f1 };
 constexpr array<Square, 4> KING_CASTLE_END_SQ = { c8, g8, c1, g1 };
 
@@ -76,6 +78,8 @@ struct Board {
     u64 attackersTo(Square sq, u64 occ) const;
 
     u64 roughKeyAfter(Move m) const;
+    // Pawn and major keys after a move, to find the correction history entries of the child
+    std::pair<u64, u64> correctionKeysAfter(Move m) const;
 
     void reset();
 
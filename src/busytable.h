@@ -0,0 +1,32 @@
+#pragma once
+
+#include "types.h"
+
+#include <atomic>
+#include <memory>
+
+// Positions some thread is searching right now, shared by every thread in ABDADA mode
+// A slot only holds the last key that entered it, so a collision can hide a busy position but never invents one
+class BusyTable {
+    static constexpr usize SIZE = 65536;
+
+    std::unique_ptr<std::atomic<u64>[]> keys;
+
+   public:
+    BusyTable() :
+        keys(std::make_unique<std::atomic<u64>[]>(SIZE)) {}
+
+    bool isBusy(const u64 key) const {
+        return keys[key % SIZE].load(std::memory_order_relaxed) == key;
+    }
+
+    void enter(const u64 key) {
+        keys[key % SIZE].store(key, std::memory_order_relaxed);
+    }
+
+    // Another thread may have entered the slot since, its mark is kept
+    void leave(const u64 key) {
+        u64 expected = key;
+        keys[key % SIZE].compare_exchange_strong(expected, 0, std::memory_order_relaxed);
+    }
+};
@@ -15,20 +15,58 @@ constexpr usize MAX_PLY     = 255;
 constexpr i16   BENCH_DEPTH = 9;
 
 inline usize MOVE_OVERHEAD = 20;
+inline usize MULTI_PV      = 1;
+// Nodes counted as one millisecond of the clock, 0 uses the real clock
+inline usize NODES_TIME = 0;
+// Whether helper threads perturb their LMR reductions
+inline bool SMP_LMR_PERTURBATION = false;
+// Whether threads defer moves other threads are searching (ABDADA) instead of only sharing the TT
+inline bool ABDADA = false;
+// Minimum remaining depth at which ABDADA marks and defers moves
+constexpr i16 ABDADA_MIN_DEPTH = 4;
+// Whether threads only share TT writes and stops at fixed node epochs, so depth limited searches are reproducible
+inline bool DETERMINISTIC_SMP = false;
+// Nodes each thread searches between two synchronisations in deterministic mode
+constexpr u64 DETERMINISTIC_EPOCH_NODES = 4096;
+// Entries of each thread's private view of the TT in deterministic mode
+constexpr usize DETERMINISTIC_OVERLAY_SIZE = 65536;
+
+// Size of each thread's eval cache in KiB, small enough to stay in L2
+inline usize EVAL_CACHE_SIZE = 256;
+
+// ************ TABLEBASES ************
+inline usize SYZYGY_PROBE_DEPTH = 1;  // Minimum depth to probe at inside the search
+inline usize SYZYGY_PROBE_LIMIT = 7;  // Maximum number of pieces to probe with
+// Maximum probes per thread at each remaining depth in one search, 0 for no limit
+inline usize SYZYGY_PROBES_PER_DEPTH = 0;
 
 // ************ NNUE ************
 constexpr i16    QA             = 255;
 constexpr i16    QB             = 64;
 constexpr i16    EVAL_SCALE     = 400;
+// Default architecture, used for the embedded network
+// Other architectures that can be loaded at runtime are listed in NetworkArchs in nnue.h
 constexpr size_t HL_SIZE        = 1024;
 constexpr size_t OUTPUT_BUCKETS = 8;
 
+// Dense layers after the feature transformer, (768->HL)x2->L2->L3->1xOUTPUT_BUCKETS
+// An L2_SIZE of 0 is a single layer (768->HL)x2->1xOUTPUT_BUCKETS network
+constexpr size_t L2_SIZE = 0;
+constexpr size_t L3_SIZE = 0;
+
+// Multi layer quantisation
+constexpr int FT_SHIFT = 9;   // Pairwise products are shifted down to fit in [0, 127]
+constexpr i16 L1_Q     = 64;  // First dense layer weights are i8 quantised by L1_Q
+
 constexpr int ReLU   = 0;
 constexpr int CReLU  = 1;
 constexpr int SCReLU = 2;
 
 constexpr int ACTIVATION = SCReLU;
 
+// Positions refreshed and run through the output layer together by batched evaluation
+constexpr size_t EVAL_BATCH_SIZE = 16;
+
 // ************ VERIFICATIONS ************
 constexpr bool VERIFY_BOARD_KEYAFTER = false;
 constexpr bool VERIFY_BOARD_HASH     = false;
\ No newline at end of file
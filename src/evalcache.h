@@ -0,0 +1,67 @@
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <vector>
+
+struct EvalCacheEntry {
+    u32 key;
+    i32 eval;
+};
+
+// Direct mapped cache of raw network outputs, owned by a single thread so it needs no synchronisation
+class EvalCache {
+    std::vector<EvalCacheEntry> table;
+
+   public:
+    u64 probes = 0;
+    u64 hits   = 0;
+
+    explicit EvalCache(const usize sizeKiB) {
+        resize(sizeKiB);
+    }
+
+    void resize(const usize sizeKiB) {
+        table.assign(sizeKiB * 1024 / sizeof(EvalCacheEntry), EvalCacheEntry{});
+        probes = 0;
+        hits   = 0;
+    }
+
+    void clear() {
+        std::fill(table.begin(), table.end(), EvalCacheEntry{});
+    }
+
+    // Indexed by the high bits of the key, the low bits are stored to verify the entry
+    u64 index(const u64 key) const {
+        return static_cast<u64>((static_cast<u128>(key) * static_cast<u128>(table.size())) >> 64);
+    }
+
+    void prefetch(const u64 key) const {
+        if (!table.empty())
+            __builtin_prefetch(&table[index(key)]);
+    }
+
+    bool probe(const u64 key, i32& eval) {
+        if (table.empty())
+            return false;
+
+        probes++;
+        const EvalCacheEntry& entry = table[index(key)];
+        if (entry.key != static_cast<u32>(key))
+            return false;
+
+        hits++;
+        eval = entry.eval;
+        return true;
+    }
+
+    void store(const u64 key, const i32 eval) {
+        if (!table.empty())
+            table[index(key)] = { static_cast<u32>(key), eval };
+    }
+
+    usize sizeBytes() const {
+        return table.size() * sizeof(EvalCacheEntry);
+    }
+};
\ No newline at end of file
@@ -3,7 +3,8 @@
 #include "nnue.h"
 
 extern bool chess960;
-extern NNUE nnue;
+extern NetworkSlot nnue;
+extern NetworkSlot smallNnue;
 
 extern MultiArray<u64, 64, 64> LINE;
 extern MultiArray<u64, 64, 64> LINESEG;
\ No newline at end of file
@@ -39,6 +39,9 @@ template<MovegenMode mode>
 void kingMoves(const Board& board, MoveList& moves);
 void initializeAllDatabases();
 
+// Overwrites moves, the search fills lists it keeps outside its stack frames
+template<MovegenMode mode>
+void generateMoves(const Board& board, MoveList& moves);
 template<MovegenMode mode>
 MoveList generateMoves(const Board& board);
 MoveList generateLegalMoves(Board& board);
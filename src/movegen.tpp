@@ -196,17 +196,22 @@ void Movegen::kingMoves(const Board& board, MoveList& moves) {
 }
 
 template<MovegenMode mode>
-MoveList Movegen::generateMoves(const Board& board) {
-    MoveList moves;
+void Movegen::generateMoves(const Board& board, MoveList& moves) {
+    moves.length = 0;
     kingMoves<mode>(board, moves);
     if (board.doubleCheck)
-        return moves;
+        return;
 
     pawnMoves<mode>(board, moves);
     knightMoves<mode>(board, moves);
     bishopMoves<mode>(board, moves);
     rookMoves<mode>(board, moves);
     // Note: Queen moves are done at the same time as bishop/rook moves
+}
 
+template<MovegenMode mode>
+MoveList Movegen::generateMoves(const Board& board) {
+    MoveList moves;
+    generateMoves<mode>(board, moves);
     return moves;
 }
\ No newline at end of file
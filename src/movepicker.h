@@ -2,10 +2,12 @@
 
 #include "move.h"
 #include "movegen.h"
+#include "search.h"
 #include "tunable.h"
 #include "types.h"
 
-inline int evaluateMove(const Board& board, const ThreadData& thisThread, const Move m) {
+// The search stack is null in quiescence search, quiets are then ordered by butterfly history alone
+inline int evaluateMove(const Board& board, const ThreadData& thisThread, const SearchStack* ss, const Move m) {
     const Square from = m.from();
     const Square to   = m.to();
     if (board.isCapture(m))
@@ -13,22 +15,34 @@ inline int evaluateMove(const Board& board, const ThreadData& thisThread, const
              + getPieceValue(board.getPiece(to)) * MO_VICTIM_SCALAR                 // Prioritize capturing stronger pieces
              + thisThread.getCaptureHistory(board, m) * MO_CAPTHIST_WEIGHT / 1024;  // Probe the capture history
 
-    return thisThread.getHistory(board, m);
+    if (ss == nullptr)
+        return thisThread.getHistory(board, m);
+    if (m == ss->killer)
+        return 100'000;  // Below good captures, above every quiet's history
+    return thisThread.getQuietHistory(board, ss, m);
 }
 
 template<MovegenMode mode>
 struct Movepicker {
-    MoveList        moves;
-    array<int, 256> moveScores;
-    u16             seen;
+    MoveList&        moves;
+    array<int, 256>& moveScores;
+    u16              seen;
 
-    Movepicker(const Board& board, const ThreadData& thisThread, const Move ttMove) {
-        moves = Movegen::generateMoves<mode>(board);
-        seen  = 0;
+    // The lists live in the frame's PlyData, the picker only keeps references
+    Movepicker(const Board& board, const ThreadData& thisThread, const SearchStack* ss, const Move ttMove, PlyData& plyData) :
+        moves(plyData.moves),
+        moveScores(plyData.moveScores),
+        seen(0) {
+        Movegen::generateMoves<mode>(board, moves);
+
+        // Capture history entries are scattered, so load them all before scoring so the SEE calls hide the misses
+        for (usize i = 0; i < moves.length; i++)
+            if (board.isCapture(moves.moves[i]))
+                __builtin_prefetch(&thisThread.getCaptureHistory(board, moves.moves[i]));
 
         for (usize i = 0; i < moves.length; i++) {
             const Move m  = moves.moves[i];
-            moveScores[i] = evaluateMove(board, thisThread, m) + 900'000 * (m == ttMove);
+            moveScores[i] = evaluateMove(board, thisThread, ss, m) + 900'000 * (m == ttMove);
         }
     }
 
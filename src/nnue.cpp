@@ -2,16 +2,36 @@
 #include "accumulator.h"
 #include "board.h"
 #include "config.h"
+#include "globals.h"
 #include "search.h"
 #include "simd.h"
+#include "stopwatch.h"
 #include "thread.h"
 #include "util.h"
 
 #include "../external/fmt/fmt/format.h"
 
 #include <algorithm>
+#include <bit>
 #include <cstring>
 #include <fstream>
+#include <memory>
+#include <random>
+#include <span>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
 
 i16 NNUE::ReLU(const i16 x) {
     if (x < 0)
@@ -35,17 +55,55 @@ i32 NNUE::SCReLU(const i16 x) {
     return x * x;
 }
 
+template<typename T>
+static T readWeight(std::istream& stream) {
+    if constexpr (std::is_floating_point_v<T>)
+        return std::bit_cast<T>(readLittleEndian<i32>(stream));
+    else
+        return readLittleEndian<T>(stream);
+}
+
+template<typename T, usize N>
+static void readWeights(std::istream& stream, array<T, N>& weights) {
+    for (T& w : weights)
+        w = readWeight<T>(stream);
+}
+
+template<usize HL, usize BUCKETS, int ACTIVATION>
+void SingleLayer<HL, BUCKETS, ACTIVATION>::load(std::istream& stream) {
+    for (auto& bucket : weightsToOut)
+        readWeights(stream, bucket);
+    readWeights(stream, outputBias);
+}
+
 #if defined(__x86_64__) || defined(__amd64__) || (defined(_WIN64) && (defined(_M_X64) || defined(_M_AMD64)) || defined(__ARM_NEON))
-i32 NNUE::vectorizedSCReLU(const Accumulator& stm, const Accumulator& nstm, const usize bucket) const {
+static simd::Vector<i16> loadAccumulator(const Accumulator& accumulator, const usize i) {
+    return simd::load_ep<i16>(&accumulator[i]);
+}
+
+template<usize ADDS, usize SUBS>
+static simd::Vector<i16> loadAccumulator(const LazyAccumulator<ADDS, SUBS>& accumulator, const usize i) {
+    using namespace simd;
+    Vector<i16> values = load_ep<i16>(&accumulator.parent[i]);
+    for (const i16* row : accumulator.addRows)
+        values = add_ep<i16>(values, load_ep<i16>(&row[i]));
+    for (const i16* row : accumulator.subRows)
+        values = sub_ep<i16>(values, load_ep<i16>(&row[i]));
+    return values;
+}
+
+template<usize HL, usize BUCKETS, int ACTIVATION>
+template<typename Input>
+i32 SingleLayer<HL, BUCKETS, ACTIVATION>::vectorizedSCReLU(const Input& stm, const Input& nstm, const usize bucket) const {
     using namespace simd;
-    static_assert(HL_SIZE % VECTOR_SIZE<i16> == 0, "HL size is not compatible with the size of this CPU's native register");
+    static_assert(HL % VECTOR_SIZE<i16> == 0, "HL size is not compatible with the size of this CPU's native register");
 
     Vector<i32> accumulator{};
 
-    for (usize i = 0; i < HL_SIZE; i += VECTOR_SIZE<i16>) {
+    for (usize i = 0; i < HL; i += VECTOR_SIZE<i16>) {
         // Load accumulators
-        const Vector<i16> stmAccumValues  = load_ep<i16>(&stm[i]);
-        const Vector<i16> nstmAccumValues = load_ep<i16>(&nstm[i]);
+        const Vector<i16> stmAccumValues  = loadAccumulator(stm, i);
+        const Vector<i16> nstmAccumValues = loadAccumulator(nstm, i);
 
         // Clamp values
         const Vector<i16> stmClamped  = clamp_ep<i16>(stmAccumValues, 0, QA);
@@ -53,7 +111,7 @@ i32 NNUE::vectorizedSCReLU(const Accumulator& stm, const Accumulator& nstm, cons
 
         // Load weights
         const Vector<i16> stmWeights  = load_ep<i16>(&weightsToOut[bucket][i]);
-        const Vector<i16> nstmWeights = load_ep<i16>(&weightsToOut[bucket][i + HL_SIZE]);
+        const Vector<i16> nstmWeights = load_ep<i16>(&weightsToOut[bucket][i + HL]);
 
         // SCReLU it
         const Vector<i32> stmActivated  = madd_epi16(stmClamped, mullo_ep(stmClamped, stmWeights));
@@ -65,160 +123,921 @@ i32 NNUE::vectorizedSCReLU(const Accumulator& stm, const Accumulator& nstm, cons
 
     return reduce_ep<i32>(accumulator);
 }
+
+template<usize HL, usize BUCKETS, int ACTIVATION>
+void SingleLayer<HL, BUCKETS, ACTIVATION>::vectorizedSCReLUBatch(const Accumulator* const* stm, const Accumulator* const* nstm, const usize count, const usize bucket, i64* output) const {
+    using namespace simd;
+
+    array<Vector<i32>, EVAL_BATCH_SIZE> accumulators{};
+
+    for (usize i = 0; i < HL; i += VECTOR_SIZE<i16>) {
+        // Weights are loaded once for the whole batch
+        const Vector<i16> stmWeights  = load_ep<i16>(&weightsToOut[bucket][i]);
+        const Vector<i16> nstmWeights = load_ep<i16>(&weightsToOut[bucket][i + HL]);
+
+        for (usize position = 0; position < count; position++) {
+            const Vector<i16> stmClamped  = clamp_ep<i16>(load_ep<i16>(&(*stm[position])[i]), 0, QA);
+            const Vector<i16> nstmClamped = clamp_ep<i16>(load_ep<i16>(&(*nstm[position])[i]), 0, QA);
+
+            accumulators[position] = add_ep<i32>(accumulators[position], madd_epi16(stmClamped, mullo_ep(stmClamped, stmWeights)));
+            accumulators[position] = add_ep<i32>(accumulators[position], madd_epi16(nstmClamped, mullo_ep(nstmClamped, nstmWeights)));
+        }
+    }
+
+    for (usize position = 0; position < count; position++)
+        output[position] = reduce_ep<i32>(accumulators[position]);
+}
 #else
     #pragma message("Using compiler optimized NNUE inference")
-i32 NNUE::vectorizedSCReLU(const Accumulator& stm, const Accumulator& nstm, const usize bucket) {
+template<usize HL, usize BUCKETS, int ACTIVATION>
+template<typename Input>
+i32 SingleLayer<HL, BUCKETS, ACTIVATION>::vectorizedSCReLU(const Input& stm, const Input& nstm, const usize bucket) const {
     i32 res = 0;
 
     #pragma unroll
-    for (usize i = 0; i < HL_SIZE; i++) {
-        res += (i32) SCReLU(stm[i]) * weightsToOut[bucket][i];
-        res += (i32) SCReLU(nstm[i]) * weightsToOut[bucket][i + HL_SIZE];
+    for (usize i = 0; i < HL; i++) {
+        res += (i32) NNUE::SCReLU(stm[i]) * weightsToOut[bucket][i];
+        res += (i32) NNUE::SCReLU(nstm[i]) * weightsToOut[bucket][i + HL];
     }
     return res;
 }
+
+template<usize HL, usize BUCKETS, int ACTIVATION>
+void SingleLayer<HL, BUCKETS, ACTIVATION>::vectorizedSCReLUBatch(const Accumulator* const* stm, const Accumulator* const* nstm, const usize count, const usize bucket, i64* output) const {
+    for (usize position = 0; position < count; position++)
+        output[position] = vectorizedSCReLU(*stm[position], *nstm[position], bucket);
+}
 #endif
 
-// Finds the input feature
-usize NNUE::feature(const Color perspective, const Color color, const PieceType piece, const Square square) {
-    const usize colorIndex  = (perspective == color) ? 0 : 1;
-    const usize squareIndex = (perspective == BLACK) ? flipRank(square) : static_cast<int>(square);
+template<usize HL, usize BUCKETS, int ACTIVATION>
+template<typename Input>
+i32 SingleLayer<HL, BUCKETS, ACTIVATION>::forward(const Input& stm, const Input& nstm, const usize bucket) const {
+    // Accumulate output for STM and OPP using separate weight segments
+    i64 eval = 0;
 
-    return colorIndex * 64 * 6 + piece * 64 + squareIndex;
+    if constexpr (ACTIVATION != ::SCReLU) {
+        for (usize i = 0; i < HL; i++) {
+            // First HL weights are for STM
+            if constexpr (ACTIVATION == ::ReLU)
+                eval += NNUE::ReLU(stm[i]) * weightsToOut[bucket][i];
+            if constexpr (ACTIVATION == ::CReLU)
+                eval += NNUE::CReLU(stm[i]) * weightsToOut[bucket][i];
+
+            // Last HL weights are for OPP
+            if constexpr (ACTIVATION == ::ReLU)
+                eval += NNUE::ReLU(nstm[i]) * weightsToOut[bucket][HL + i];
+            if constexpr (ACTIVATION == ::CReLU)
+                eval += NNUE::CReLU(nstm[i]) * weightsToOut[bucket][HL + i];
+        }
+    }
+    else
+        eval = vectorizedSCReLU(stm, nstm, bucket);
+
+    return dequantize(eval, bucket);
 }
 
-void NNUE::loadNetwork(const string& filepath) {
-    std::ifstream stream(filepath, std::ios::binary);
-    if (!stream.is_open()) {
-        cerr << "Failed to open file: " + filepath << endl;
-        cerr << "Expect engine to not work as intended with bad evaluation" << endl;
+template<usize HL, usize BUCKETS, int ACTIVATION>
+i32 SingleLayer<HL, BUCKETS, ACTIVATION>::dequantize(i64 eval, const usize bucket) const {
+    // Dequantization
+    if constexpr (ACTIVATION == ::SCReLU)
+        eval /= QA;
+
+    eval += outputBias[bucket];
+
+    // Apply output bias and scale the result
+    return (eval * EVAL_SCALE) / (QA * QB);
+}
+
+template<usize HL, usize BUCKETS, int ACTIVATION>
+void SingleLayer<HL, BUCKETS, ACTIVATION>::forwardBatch(const Accumulator* const* stm, const Accumulator* const* nstm, const usize count, const usize bucket, i32* output) const {
+    if constexpr (ACTIVATION != ::SCReLU) {
+        for (usize position = 0; position < count; position++)
+            output[position] = forward(*stm[position], *nstm[position], bucket);
+    }
+    else {
+        array<i64, EVAL_BATCH_SIZE> evals;
+        vectorizedSCReLUBatch(stm, nstm, count, bucket, evals.data());
+        for (usize position = 0; position < count; position++)
+            output[position] = dequantize(evals[position], bucket);
+    }
+}
+
+template<usize IN, usize OUT, usize BUCKETS>
+void SparseAffine<IN, OUT, BUCKETS>::load(std::istream& stream) {
+    for (auto& bucket : weights)
+        readWeights(stream, bucket);
+    for (auto& bucket : biases)
+        readWeights(stream, bucket);
+}
+
+template<usize IN, usize OUT, usize BUCKETS>
+void SparseAffine<IN, OUT, BUCKETS>::forward(const u8* input, float* output, const usize bucket) const {
+    using namespace simd;
+    constexpr usize CHUNKS      = IN / 4;
+    constexpr usize OUT_VECTORS = OUT / VECTOR_SIZE<i32>;
+    static_assert(CHUNKS % VECTOR_SIZE<i32> == 0, "Input size is not compatible with the size of this CPU's native register");
+    static_assert(OUT % VECTOR_SIZE<i32> == 0, "Output size is not compatible with the size of this CPU's native register");
+
+    // Find the groups of 4 inputs that have at least one non-zero value
+    array<u16, CHUNKS> nonzero;
+    usize              nonzeroCount = 0;
+
+    for (usize i = 0; i < CHUNKS; i += VECTOR_SIZE<i32>) {
+        u32 mask = nonzeroMask_epi32(load_ep<i32>(&input[i * 4]));
+        while (mask) {
+            nonzero[nonzeroCount++] = i + std::countr_zero(mask);
+            mask &= mask - 1;
+        }
     }
 
-    // Load weightsToHL
-    for (i16& weight : weightsToHL) {
-        weight = readLittleEndian<i16>(stream);
+    // Only multiply the weight rows of those groups
+    Vector<i32> sums[OUT_VECTORS] = {};
+
+    for (usize n = 0; n < nonzeroCount; n++) {
+        const usize chunk = nonzero[n];
+
+        i32 packedInput;
+        std::memcpy(&packedInput, &input[chunk * 4], sizeof(i32));
+        const Vector<i32> inputs = set1_ep<i32>(packedInput);
+
+        const i8* row = &weights[bucket][chunk * OUT * 4];
+        for (usize j = 0; j < OUT_VECTORS; j++)
+            sums[j] = dpbusd_epi32(sums[j], inputs, load_ep<i32>(&row[j * VECTOR_BYTES]));
     }
 
-    // Load hiddenLayerBias
-    for (i16& bias : hiddenLayerBias) {
-        bias = readLittleEndian<i16>(stream);
+    // Dequantization
+    i32 raw[OUT];
+    std::memcpy(raw, sums, sizeof(raw));
+
+    constexpr float dequant = 1.0f / ((QA * QA >> FT_SHIFT) * L1_Q);
+    for (usize i = 0; i < OUT; i++)
+        output[i] = raw[i] * dequant + biases[bucket][i];
+}
+
+template<usize IN, usize OUT, usize BUCKETS>
+void Affine<IN, OUT, BUCKETS>::load(std::istream& stream) {
+    for (auto& bucket : weights)
+        readWeights(stream, bucket);
+    for (auto& bucket : biases)
+        readWeights(stream, bucket);
+}
+
+template<usize IN, usize OUT, usize BUCKETS>
+void Affine<IN, OUT, BUCKETS>::forward(const float* input, float* output, const usize bucket) const {
+    std::copy(biases[bucket].begin(), biases[bucket].end(), output);
+
+    for (usize i = 0; i < IN; i++) {
+        if (input[i] == 0)
+            continue;
+        for (usize o = 0; o < OUT; o++)
+            output[o] += input[i] * weights[bucket][i * OUT + o];
     }
+}
 
-    // Load weightsToOut
-    for (auto& i : weightsToOut) {
-        for (i16& w : i) {
-            w = readLittleEndian<i16>(stream);
+// Clipped pairwise multiplication, the first half of each accumulator is multiplied by its second half
+template<usize HL>
+static void pairwiseActivate(const Accumulator& stm, const Accumulator& nstm, u8* output) {
+    constexpr usize HALF = HL / 2;
+
+    for (usize i = 0; i < HALF; i++) {
+        const u16 stmA  = std::clamp<i16>(stm[i], 0, QA);
+        const u16 stmB  = std::clamp<i16>(stm[i + HALF], 0, QA);
+        const u16 nstmA = std::clamp<i16>(nstm[i], 0, QA);
+        const u16 nstmB = std::clamp<i16>(nstm[i + HALF], 0, QA);
+
+        output[i]        = static_cast<u16>(stmA * stmB) >> FT_SHIFT;
+        output[i + HALF] = static_cast<u16>(nstmA * nstmB) >> FT_SHIFT;
+    }
+}
+
+template<usize N>
+static void activateSCReLU(array<float, N>& values) {
+    for (float& v : values) {
+        v = std::clamp(v, 0.0f, 1.0f);
+        v *= v;
+    }
+}
+
+template<usize HL, usize L2, usize L3, usize BUCKETS>
+void LayerStack<HL, L2, L3, BUCKETS>::load(std::istream& stream) {
+    l1.load(stream);
+    l2.load(stream);
+    l3.load(stream);
+}
+
+template<usize HL, usize L2, usize L3, usize BUCKETS>
+i32 LayerStack<HL, L2, L3, BUCKETS>::forward(const Accumulator& stm, const Accumulator& nstm, const usize bucket) const {
+    alignas(64) array<u8, HL> ftOut;
+    pairwiseActivate<HL>(stm, nstm, ftOut.data());
+
+    alignas(64) array<float, L2> l1Out;
+    l1.forward(ftOut.data(), l1Out.data(), bucket);
+    activateSCReLU(l1Out);
+
+    alignas(64) array<float, L3> l2Out;
+    l2.forward(l1Out.data(), l2Out.data(), bucket);
+    activateSCReLU(l2Out);
+
+    float eval;
+    l3.forward(l2Out.data(), &eval, bucket);
+
+    return eval * EVAL_SCALE;
+}
+
+template<usize HL, usize L2, usize L3, usize BUCKETS>
+void LayerStack<HL, L2, L3, BUCKETS>::forwardBatch(const Accumulator* const* stm, const Accumulator* const* nstm, const usize count, const usize bucket, i32* output) const {
+    for (usize position = 0; position < count; position++)
+        output[position] = forward(*stm[position], *nstm[position], bucket);
+}
+
+template<typename Arch>
+void NetworkWeights<Arch>::loadNetwork(std::istream& stream) {
+    readWeights(stream, weightsToHL);
+    readWeights(stream, hiddenLayerBias);
+    output.load(stream);
+}
+
+static_assert(sizeof(NetworkHeader) <= NETWORK_HEADER_SIZE && NETWORK_HEADER_SIZE % 64 == 0);
+
+template<typename Arch>
+NetworkHeader NetworkHeader::of() {
+    static_assert(std::is_trivially_copyable_v<NetworkWeights<Arch>>, "Networks are mapped directly from files");
+    static_assert(alignof(NetworkWeights<Arch>) <= 64);
+
+    NetworkHeader header{};
+    header.magic         = NETWORK_MAGIC;
+    header.version       = NETWORK_VERSION;
+    header.headerSize    = NETWORK_HEADER_SIZE;
+    header.inputSize     = 768;
+    header.hlSize        = Arch::HL;
+    header.l2Size        = Arch::L2;
+    header.l3Size        = Arch::L3;
+    header.outputBuckets = Arch::BUCKETS;
+    header.activation    = Arch::ACTIVATION;
+    header.qa            = QA;
+    header.qb            = QB;
+    header.evalScale     = EVAL_SCALE;
+    header.ftShift       = FT_SHIFT;
+    header.l1Q           = L1_Q;
+    header.payloadSize   = sizeof(NetworkWeights<Arch>);
+    return header;
+}
+
+// FNV-1a over 8 byte words
+static u64 hashPayload(const u8* data, const usize size) {
+    constexpr u64 PRIME = 0x100000001B3;
+
+    u64   hash = 0xCBF29CE484222325;
+    usize i    = 0;
+    for (; i + sizeof(u64) <= size; i += sizeof(u64)) {
+        u64 word;
+        std::memcpy(&word, data + i, sizeof(u64));
+        hash = (hash ^ word) * PRIME;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ data[i]) * PRIME;
+    return hash;
+}
+
+// Lets headerless networks be parsed straight from memory
+struct MemoryBuffer : std::streambuf {
+    MemoryBuffer(const u8* data, const usize size) {
+        char* begin = reinterpret_cast<char*>(const_cast<u8*>(data));
+        setg(begin, begin, begin + size);
+    }
+};
+
+static string archName(const NetworkHeader& header) {
+    constexpr array<const char*, 3> ACTIVATIONS = { "ReLU", "CReLU", "SCReLU" };
+    const char*                     activation  = header.activation < ACTIVATIONS.size() ? ACTIVATIONS[header.activation] : "unknown";
+
+    if (header.l2Size > 0)
+        return fmt::format("({}->{})x2->{}->{}->1x{} {}", header.inputSize, header.hlSize, header.l2Size, header.l3Size, header.outputBuckets, activation);
+    return fmt::format("({}->{})x2->1x{} {}", header.inputSize, header.hlSize, header.outputBuckets, activation);
+}
+
+template<usize... I>
+static string availableArchs(std::index_sequence<I...>) {
+    string names;
+    ((names += (I == 0 ? "" : ", ") + archName(NetworkHeader::of<std::tuple_element_t<I, NetworkArchs>>())), ...);
+    return names;
+}
+
+static string availableArchs() {
+    return availableArchs(std::make_index_sequence<std::tuple_size_v<NetworkArchs>>{});
+}
+
+// Returns an empty string if the header describes a network of the expected architecture
+static string validateHeader(const NetworkHeader& header, const NetworkHeader& expected, const usize fileSize) {
+    const array<std::tuple<const char*, i64, i64>, 5> fields = { { { "QA", header.qa, expected.qa },
+                                                                   { "QB", header.qb, expected.qb },
+                                                                   { "eval scale", header.evalScale, expected.evalScale },
+                                                                   { "FT shift", header.ftShift, expected.ftShift },
+                                                                   { "L1 quantisation", header.l1Q, expected.l1Q } } };
+    for (const auto& [name, value, expectedValue] : fields)
+        if (value != expectedValue)
+            return fmt::format("{} is {}, this engine was compiled for {}", name, value, expectedValue);
+
+    if (header.payloadSize != expected.payloadSize)
+        return fmt::format("weights are {} bytes, expected {}", header.payloadSize, expected.payloadSize);
+    if (fileSize < header.headerSize + header.payloadSize)
+        return fmt::format("file is truncated, {} of {} bytes present", fileSize, header.headerSize + header.payloadSize);
+
+    return "";
+}
+
+static bool sameArch(const NetworkHeader& a, const NetworkHeader& b) {
+    return a.inputSize == b.inputSize && a.hlSize == b.hlSize && a.l2Size == b.l2Size && a.l3Size == b.l3Size && a.outputBuckets == b.outputBuckets && a.activation == b.activation;
+}
+
+// Builds the inference for the architecture in the header, or returns nullptr if none match
+template<usize I = 0>
+static std::unique_ptr<NNUE> loadHeadered(const NetworkHeader& header, const u8* payload, const usize fileSize) {
+    if constexpr (I == std::tuple_size_v<NetworkArchs>) {
+        cerr << "Invalid network: architecture " << archName(header) << " is not supported, this engine supports " << availableArchs() << endl;
+        return nullptr;
+    }
+    else {
+        using Arch        = std::tuple_element_t<I, NetworkArchs>;
+        using Weights     = NetworkWeights<Arch>;
+        const auto expect = NetworkHeader::of<Arch>();
+
+        if (!sameArch(header, expect))
+            return loadHeadered<I + 1>(header, payload, fileSize);
+
+        const string error = validateHeader(header, expect, fileSize);
+        if (!error.empty()) {
+            cerr << "Invalid network: " << error << endl;
+            return nullptr;
+        }
+
+        if (hashPayload(payload, header.payloadSize) != header.hash) {
+            cerr << "Invalid network: checksum does not match, the file is corrupted" << endl;
+            return nullptr;
         }
+
+        // Point directly at the weights unless they are misaligned in memory
+        if (reinterpret_cast<uintptr_t>(payload) % alignof(Weights) == 0)
+            return std::make_unique<NNUEImpl<Arch>>(reinterpret_cast<const Weights*>(payload));
+
+        auto owned = std::make_unique<Weights>();
+        std::memcpy(owned.get(), payload, sizeof(Weights));
+        return std::make_unique<NNUEImpl<Arch>>(std::move(owned));
+    }
+}
+
+// Headerless networks carry no architecture, so the size is the only way to tell them apart
+// bullet pads its output to a multiple of 64 bytes, the padding is ignored
+constexpr usize HEADERLESS_PADDING = 64;
+
+template<usize I = 0>
+static std::unique_ptr<NNUE> loadHeaderless(const u8* data, const usize size) {
+    if constexpr (I == std::tuple_size_v<NetworkArchs>) {
+        cerr << "Invalid network: no supported architecture has a headerless size of " << size << " bytes, this engine supports " << availableArchs() << endl;
+        return nullptr;
     }
+    else {
+        using Arch    = std::tuple_element_t<I, NetworkArchs>;
+        using Weights = NetworkWeights<Arch>;
 
-    // Load outputBias
-    for (i16& b : outputBias) {
-        b = readLittleEndian<i16>(stream);
+        if (size < Weights::RAW_SIZE || size >= Weights::RAW_SIZE + HEADERLESS_PADDING)
+            return loadHeaderless<I + 1>(data, size);
+
+        MemoryBuffer buffer(data, size);
+        std::istream stream(&buffer);
+
+        auto owned = std::make_unique<Weights>();
+        owned->loadNetwork(stream);
+        return std::make_unique<NNUEImpl<Arch>>(std::move(owned));
     }
 }
 
-// Returns the output of the NN
-int NNUE::forwardPass(const Board* board, const AccumulatorPair& accumulators) const {
-    const usize divisor      = 32 / OUTPUT_BUCKETS;
-    const usize outputBucket = (popcount(board->pieces()) - 2) / divisor;
+// Read only view of a file, shared with every other process mapping it
+static const u8* mapFile(const string& filepath, usize& size) {
+#ifdef _WIN32
+    const HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
 
-    const Accumulator& accumulatorSTM = board->stm == WHITE ? accumulators.white_ : accumulators.black_;
-    const Accumulator& accumulatorOPP = ~board->stm == WHITE ? accumulators.white_ : accumulators.black_;
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = fileSize.QuadPart;
 
-    // Accumulate output for STM and OPP using separate weight segments
-    i64 eval = 0;
+    const HANDLE mapping = size > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (mapping == nullptr)
+        return nullptr;
 
-    if constexpr (ACTIVATION != ::SCReLU) {
-        for (usize i = 0; i < HL_SIZE; i++) {
-            // First HL_SIZE weights are for STM
-            if constexpr (ACTIVATION == ::ReLU)
-                eval += ReLU(accumulatorSTM[i]) * weightsToOut[outputBucket][i];
-            if constexpr (ACTIVATION == ::CReLU)
-                eval += CReLU(accumulatorSTM[i]) * weightsToOut[outputBucket][i];
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    return static_cast<const u8*>(data);
+#else
+    const int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
 
-            // Last HL_SIZE weights are for OPP
-            if constexpr (ACTIVATION == ::ReLU)
-                eval += ReLU(accumulatorOPP[i]) * weightsToOut[outputBucket][HL_SIZE + i];
-            if constexpr (ACTIVATION == ::CReLU)
-                eval += CReLU(accumulatorOPP[i]) * weightsToOut[outputBucket][HL_SIZE + i];
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+    size = fileStat.st_size;
+
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return data == MAP_FAILED ? nullptr : static_cast<const u8*>(data);
+#endif
+}
+
+static void unmapFile(const u8* data, [[maybe_unused]] const usize size) {
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<u8*>(data), size);
+#endif
+}
+
+Network::~Network() {
+    unmap();
+}
+
+Network::Network(Network&& other) noexcept {
+    *this = std::move(other);
+}
+
+Network& Network::operator=(Network&& other) noexcept {
+    unmap();
+    impl        = std::move(other.impl);
+    mapping     = std::exchange(other.mapping, nullptr);
+    mappingSize = std::exchange(other.mappingSize, 0);
+    return *this;
+}
+
+void Network::unmap() {
+    if (mapping != nullptr)
+        unmapFile(mapping, mappingSize);
+    mapping     = nullptr;
+    mappingSize = 0;
+}
+
+bool Network::load(const u8* data, const usize size) {
+    NetworkHeader header;
+    if (size >= sizeof(NetworkHeader))
+        std::memcpy(&header, data, sizeof(NetworkHeader));
+
+    if (size >= sizeof(NetworkHeader) && header.magic == NETWORK_MAGIC) {
+        if (!IS_LITTLE_ENDIAN) {
+            cerr << "Invalid network: networks can only be mapped on little endian machines" << endl;
+            return false;
+        }
+        if (header.version != NETWORK_VERSION) {
+            cerr << "Invalid network: version " << header.version << " is not supported, expected version " << NETWORK_VERSION << endl;
+            return false;
+        }
+        if (header.headerSize < sizeof(NetworkHeader) || header.headerSize % 64 != 0) {
+            cerr << "Invalid network: header size " << header.headerSize << " is not a multiple of 64" << endl;
+            return false;
         }
+
+        impl = loadHeadered(header, data + header.headerSize, size);
     }
     else
-        eval = vectorizedSCReLU(accumulatorSTM, accumulatorOPP, outputBucket);
+        impl = loadHeaderless(data, size);
 
+    return impl != nullptr;
+}
 
-    // Dequantization
-    if constexpr (ACTIVATION == ::SCReLU)
-        eval /= QA;
+bool Network::loadFile(const string& filepath) {
+    usize     size = 0;
+    const u8* data = mapFile(filepath, size);
+    if (data == nullptr) {
+        cerr << "Failed to open file: " + filepath << endl;
+        return false;
+    }
 
-    eval += outputBias[outputBucket];
+    Network loaded;
+    loaded.mapping     = data;
+    loaded.mappingSize = size;
 
-    // Apply output bias and scale the result
-    return (eval * EVAL_SCALE) / (QA * QB);
+    if (!loaded.load(data, size))
+        return false;
+
+    // Headerless networks are copied, so the mapping is no longer needed
+    if (!loaded.isMapped())
+        loaded.unmap();
+
+    *this = std::move(loaded);
+    return true;
 }
 
-// Debug feature based on SF
-void NNUE::showBuckets(const Board* board, const AccumulatorPair& accumulators) const {
-    const usize divisor     = 32 / OUTPUT_BUCKETS;
-    const usize usingBucket = (popcount(board->pieces()) - 2) / divisor;
+bool Network::loadMemory(const u8* data, const usize size) {
+    Network loaded;
+    if (!loaded.load(data, size))
+        return false;
+
+    *this = std::move(loaded);
+    return true;
+}
 
-    int staticEval = 0;
+bool Network::save(const string& filepath) const {
+    std::ofstream stream(filepath, std::ios::binary);
+    if (!stream.is_open()) {
+        cerr << "Failed to open file: " + filepath << endl;
+        return false;
+    }
 
-    cout << "+------------+------------+" << endl;
-    cout << "|   Bucket   | Evaluation |" << endl;
-    cout << "+------------+------------+" << endl;
+    NetworkHeader header = impl->header;
+    header.hash          = hashPayload(impl->data(), header.payloadSize);
 
+    array<char, NETWORK_HEADER_SIZE> headerBytes{};
+    std::memcpy(headerBytes.data(), &header, sizeof(NetworkHeader));
+
+    stream.write(headerBytes.data(), headerBytes.size());
+    stream.write(reinterpret_cast<const char*>(impl->data()), header.payloadSize);
+    return stream.good();
+}
+
+NetworkSlot::~NetworkSlot() {
+    waitForLoad();
+}
+
+std::shared_ptr<const Network> NetworkSlot::get() const {
+    std::lock_guard guard(lock);
+    return current;
+}
+
+bool NetworkSlot::load(const std::function<bool(Network&)>& loadNetwork) {
+    auto network = std::make_shared<Network>();
+    if (!loadNetwork(*network))
+        return false;
+
+    std::lock_guard guard(lock);
+    current = std::move(network);
+    return true;
+}
+
+void NetworkSlot::clear() {
+    waitForLoad();
+
+    std::lock_guard guard(lock);
+    current = nullptr;
+}
+
+void NetworkSlot::loadAsync(std::function<bool(Network&)> loadNetwork) {
+    // Loads finish in the order they were requested
+    waitForLoad();
+
+    loader = std::thread([this, loadNetwork = std::move(loadNetwork)]() {
+        if (!load(loadNetwork))
+            cerr << "Keeping the previous network" << endl;
+    });
+}
+
+void NetworkSlot::waitForLoad() {
+    if (loader.joinable())
+        loader.join();
+}
+
+template<usize BUCKETS>
+usize NNUE::outputBucket(const Board* board) {
+    const usize divisor = 32 / BUCKETS;
+    return (popcount(board->pieces()) - 2) / divisor;
+}
+
+template<typename Arch>
+NNUEImpl<Arch>::NNUEImpl(const NetworkWeights<Arch>* weights) :
+    NNUE(NetworkHeader::of<Arch>()),
+    weights(weights) {}
+
+template<typename Arch>
+NNUEImpl<Arch>::NNUEImpl(std::unique_ptr<NetworkWeights<Arch>> owned) :
+    NNUE(NetworkHeader::of<Arch>()),
+    weights(owned.get()),
+    owned(std::move(owned)) {}
+
+template<typename Arch>
+void NNUEImpl<Arch>::refresh(const Board& board, AccumulatorPair& accumulators) const {
+    accumulators.resetAccumulators<Arch::HL>(board, weights->weightsToHL.data(), weights->hiddenLayerBias.data());
+}
+
+template<typename Arch>
+void NNUEImpl<Arch>::apply(const AccumulatorPair& parent, AccumulatorPair& child) const {
+    child.apply<Arch::HL>(parent, weights->weightsToHL.data());
+}
+
+template<typename Arch>
+void NNUEImpl<Arch>::prefetch(const AccumulatorUpdate& update) const {
+    update.prefetch<Arch::HL>(weights->weightsToHL.data());
+}
+
+// Returns the output of the NN
+template<typename Arch>
+int NNUEImpl<Arch>::forwardPass(const Board* board, const AccumulatorPair& accumulators) const {
     const Accumulator& accumulatorSTM = board->stm == WHITE ? accumulators.white_ : accumulators.black_;
     const Accumulator& accumulatorOPP = ~board->stm == WHITE ? accumulators.white_ : accumulators.black_;
 
-    for (usize outputBucket = 0; outputBucket < OUTPUT_BUCKETS; outputBucket++) {
-        // Accumulate output for STM and OPP using separate weight segments
-        i64 eval = 0;
-
-        if constexpr (ACTIVATION != ::SCReLU) {
-            for (usize i = 0; i < HL_SIZE; i++) {
-                // First HL_SIZE weights are for STM
-                if constexpr (ACTIVATION == ::ReLU)
-                    eval += ReLU(accumulatorSTM[i]) * weightsToOut[outputBucket][i];
-                if constexpr (ACTIVATION == ::CReLU)
-                    eval += CReLU(accumulatorSTM[i]) * weightsToOut[outputBucket][i];
-
-                // Last HL_SIZE weights are for OPP
-                if constexpr (ACTIVATION == ::ReLU)
-                    eval += ReLU(accumulatorOPP[i]) * weightsToOut[outputBucket][HL_SIZE + i];
-                if constexpr (ACTIVATION == ::CReLU)
-                    eval += CReLU(accumulatorOPP[i]) * weightsToOut[outputBucket][HL_SIZE + i];
-            }
-        }
-        else
-            eval = vectorizedSCReLU(accumulatorSTM, accumulatorOPP, outputBucket);
+    return weights->output.forward(accumulatorSTM, accumulatorOPP, outputBucket<Arch::BUCKETS>(board));
+}
 
+template<typename Arch>
+template<usize ADDS, usize SUBS>
+int NNUEImpl<Arch>::forwardPassLazy(const Board* board, const AccumulatorPair& parent, const AccumulatorUpdate& update) const {
+    const auto lazyAccumulator = [&](const Color perspective) {
+        LazyAccumulator<ADDS, SUBS> accumulator;
+        accumulator.parent = (perspective == WHITE ? parent.white_ : parent.black_).data();
+        for (usize i = 0; i < ADDS; i++)
+            accumulator.addRows[i] = &weights->weightsToHL[update.adds[perspective][i] * Arch::HL];
+        for (usize i = 0; i < SUBS; i++)
+            accumulator.subRows[i] = &weights->weightsToHL[update.subs[perspective][i] * Arch::HL];
+        return accumulator;
+    };
 
-        // Dequantization
-        if constexpr (ACTIVATION == ::SCReLU)
-            eval /= QA;
+    return weights->output.forward(lazyAccumulator(board->stm), lazyAccumulator(~board->stm), outputBucket<Arch::BUCKETS>(board));
+}
 
-        eval += outputBias[outputBucket];
+template<typename Arch>
+int NNUEImpl<Arch>::forwardPassLazy(const Board* board, const AccumulatorPair& parent, const AccumulatorUpdate& update) const {
+    // Layer stacks need the whole accumulator for their pairwise activation
+    if constexpr (Arch::L2 > 0) {
+        OwnedAccumulatorPair<Arch::HL> child;
+        child.pending = update;
+        apply(parent, child);
+        return forwardPass(board, child);
+    }
+    else if (update.addCount == 0)
+        return forwardPass(board, parent);
+    else if (update.addCount == 1 && update.subCount == 1)
+        return forwardPassLazy<1, 1>(board, parent, update);
+    else if (update.addCount == 1)
+        return forwardPassLazy<1, 2>(board, parent, update);
+    else
+        return forwardPassLazy<2, 2>(board, parent, update);
+}
 
-        // Apply output bias and scale the result
-        staticEval = (eval * EVAL_SCALE) / (QA * QB);
+// Debug feature based on SF
+template<typename Arch>
+void NNUEImpl<Arch>::showBuckets(const Board* board, const AccumulatorPair& accumulators) const {
+    const usize usingBucket = outputBucket<Arch::BUCKETS>(board);
 
-        fmt::print("| {:<10} |  {:<+8.2f}  |", outputBucket, staticEval / 100.0);
-        if (outputBucket == usingBucket)
+    cout << "+------------+------------+" << endl;
+    cout << "|   Bucket   | Evaluation |" << endl;
+    cout << "+------------+------------+" << endl;
+
+    const Accumulator& accumulatorSTM = board->stm == WHITE ? accumulators.white_ : accumulators.black_;
+    const Accumulator& accumulatorOPP = ~board->stm == WHITE ? accumulators.white_ : accumulators.black_;
+
+    for (usize bucket = 0; bucket < Arch::BUCKETS; bucket++) {
+        const int staticEval = weights->output.forward(accumulatorSTM, accumulatorOPP, bucket);
+
+        fmt::print("| {:<10} |  {:<+8.2f}  |", bucket, staticEval / 100.0);
+        if (bucket == usingBucket)
             cout << " <- Current bucket";
         cout << endl;
-        if (outputBucket == OUTPUT_BUCKETS - 1)
+        if (bucket == Arch::BUCKETS - 1)
             cout << "+------------+------------+" << endl;
     }
 }
 
-i16 NNUE::evaluate(const Board& board, const ThreadData& thisThread) const {
+template<typename Arch>
+void NNUEImpl<Arch>::evaluateBatch(const std::span<const Board> boards, const std::span<i32> evals) const {
+    assert(boards.size() == evals.size());
+
+    // Positions sharing a bucket are evaluated together so they share output weights
+    std::vector<usize> order(boards.size());
+    std::vector<usize> buckets(boards.size());
+    for (usize i = 0; i < boards.size(); i++) {
+        order[i]   = i;
+        buckets[i] = outputBucket<Arch::BUCKETS>(&boards[i]);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const usize a, const usize b) { return buckets[a] < buckets[b]; });
+
+    const auto                               owned = std::make_unique<array<OwnedAccumulatorPair<Arch::HL>, EVAL_BATCH_SIZE>>();
+    array<AccumulatorPair*, EVAL_BATCH_SIZE> accumulators;
+    for (usize i = 0; i < EVAL_BATCH_SIZE; i++)
+        accumulators[i] = &(*owned)[i];
+
+    for (usize start = 0; start < boards.size(); start += EVAL_BATCH_SIZE) {
+        const usize count = std::min(EVAL_BATCH_SIZE, boards.size() - start);
+
+        array<const Board*, EVAL_BATCH_SIZE>       batch;
+        array<const Accumulator*, EVAL_BATCH_SIZE> stm;
+        array<const Accumulator*, EVAL_BATCH_SIZE> nstm;
+        for (usize i = 0; i < count; i++)
+            batch[i] = &boards[order[start + i]];
+
+        AccumulatorPair::resetAccumulators<Arch::HL>(batch.data(), accumulators.data(), count, weights->weightsToHL.data(), weights->hiddenLayerBias.data());
+
+        for (usize i = 0; i < count; i++) {
+            stm[i]  = batch[i]->stm == WHITE ? &accumulators[i]->white_ : &accumulators[i]->black_;
+            nstm[i] = batch[i]->stm == WHITE ? &accumulators[i]->black_ : &accumulators[i]->white_;
+        }
+
+        // Output layer over each run of positions in the same bucket
+        usize runStart = 0;
+        while (runStart < count) {
+            const usize bucket = buckets[order[start + runStart]];
+            usize       runEnd = runStart + 1;
+            while (runEnd < count && buckets[order[start + runEnd]] == bucket)
+                runEnd++;
+
+            array<i32, EVAL_BATCH_SIZE> output;
+            weights->output.forwardBatch(&stm[runStart], &nstm[runStart], runEnd - runStart, bucket, output.data());
+            for (usize i = runStart; i < runEnd; i++)
+                evals[order[start + i]] = output[i - runStart];
+
+            runStart = runEnd;
+        }
+    }
+}
+
+void NNUE::applyPendingUpdates(AccumulatorStack& accumulatorStack, const usize idx) const {
+    // The root is always written, so the walk stops before running off the stack
+    usize written = idx;
+    while (accumulatorStack[written].dirty)
+        written--;
+    for (usize i = written + 1; i <= idx; i++)
+        apply(accumulatorStack[i - 1], accumulatorStack[i]);
+}
+
+int NNUE::evaluate(const Board& board, AccumulatorStack& accumulatorStack) const {
+    applyPendingUpdates(accumulatorStack, accumulatorStack.length() - 1);
 #ifndef NDEBUG
-    AccumulatorPair verifAccumulator;
-    verifAccumulator.resetAccumulators(board);
-    if (verifAccumulator != thisThread.accumulatorStack.top())
+    OwnedAccumulatorPair<MAX_HL_SIZE> verifAccumulator;
+    refresh(board, verifAccumulator);
+    if (!verifAccumulator.equals(accumulatorStack.top(), hlSize()))
         cout << board.toString() << endl;
-    assert(verifAccumulator == thisThread.accumulatorStack.top());
+    assert(verifAccumulator.equals(accumulatorStack.top(), hlSize()));
+#endif
+    return forwardPass(&board, accumulatorStack.top());
+}
+
+int NNUE::evaluateLeaf(const Board& board, AccumulatorStack& accumulatorStack) const {
+    const AccumulatorPair& top = accumulatorStack.top();
+    if (top.dirty)
+        applyPendingUpdates(accumulatorStack, accumulatorStack.length() - 2);
+
+    const int eval = top.dirty ? forwardPassLazy(&board, accumulatorStack[accumulatorStack.length() - 2], top.pending) : forwardPass(&board, top);
+#ifndef NDEBUG
+    OwnedAccumulatorPair<MAX_HL_SIZE> verifAccumulator;
+    refresh(board, verifAccumulator);
+    assert(eval == forwardPass(&board, verifAccumulator));
 #endif
-    return std::clamp<i32>(forwardPass(&board, thisThread.accumulatorStack.top()), MATED_IN_MAX_PLY, MATE_IN_MAX_PLY);
+    return eval;
+}
+
+template<typename T, usize N>
+static void randomize(array<T, N>& arr, std::mt19937& rng) {
+    for (T& v : arr) {
+        if constexpr (std::is_floating_point_v<T>)
+            v = std::uniform_real_distribution<T>(-1, 1)(rng);
+        else if constexpr (std::is_integral_v<T>)
+            v = std::uniform_int_distribution<int>(-64, 64)(rng);
+        else
+            randomize(v, rng);
+    }
+}
+
+void evalBench() {
+    constexpr usize BENCH_L2   = 16;
+    constexpr usize BENCH_L3   = 32;
+    constexpr usize ITERATIONS = 20000;
+
+    // Accumulators come from the loaded network so the activations are as sparse as they would be in search
+    const auto                                                     network = nnue.get();
+    std::vector<Board>                                             boards;
+    std::vector<std::unique_ptr<OwnedAccumulatorPair<MAX_HL_SIZE>>> accumulators;
+    for (const string& fen : BENCH_FENS) {
+        Board board;
+        board.reset();
+        board.loadFromFEN(fen);
+
+        auto accumulator = std::make_unique<OwnedAccumulatorPair<MAX_HL_SIZE>>();
+        (*network)->refresh(board, *accumulator);
+
+        boards.push_back(board);
+        accumulators.push_back(std::move(accumulator));
+    }
+
+    // Output weights do not change the cost of either path
+    std::mt19937 rng(0);
+
+    const auto singleLayer = std::make_unique<SingleLayer<HL_SIZE, OUTPUT_BUCKETS, ACTIVATION>>();
+    randomize(singleLayer->weightsToOut, rng);
+    randomize(singleLayer->outputBias, rng);
+
+    const auto layerStack = std::make_unique<LayerStack<HL_SIZE, BENCH_L2, BENCH_L3, OUTPUT_BUCKETS>>();
+    randomize(layerStack->l1.weights, rng);
+    randomize(layerStack->l1.biases, rng);
+    randomize(layerStack->l2.weights, rng);
+    randomize(layerStack->l2.biases, rng);
+    randomize(layerStack->l3.weights, rng);
+    randomize(layerStack->l3.biases, rng);
+
+    const auto timeLayers = [&](const auto& layers) {
+        i64                                 sink = 0;
+        Stopwatch<std::chrono::nanoseconds> time;
+        for (usize iteration = 0; iteration < ITERATIONS; iteration++) {
+            for (usize i = 0; i < boards.size(); i++) {
+                const Accumulator& accumulatorSTM = boards[i].stm == WHITE ? accumulators[i]->white_ : accumulators[i]->black_;
+                const Accumulator& accumulatorOPP = ~boards[i].stm == WHITE ? accumulators[i]->white_ : accumulators[i]->black_;
+
+                sink += layers.forward(accumulatorSTM, accumulatorOPP, NNUE::outputBucket<OUTPUT_BUCKETS>(&boards[i]));
+            }
+        }
+        const double nsPerEval = time.elapsed() / static_cast<double>(ITERATIONS * boards.size());
+        return std::pair{ nsPerEval, sink };
+    };
+
+    // Share of the first dense layer's input groups that are multiplied
+    usize nonzeroChunks = 0;
+    for (usize i = 0; i < boards.size(); i++) {
+        alignas(64) array<u8, HL_SIZE> ftOut;
+        pairwiseActivate<HL_SIZE>(accumulators[i]->white_, accumulators[i]->black_, ftOut.data());
+        for (usize chunk = 0; chunk < HL_SIZE; chunk += 4)
+            nonzeroChunks += ftOut[chunk] || ftOut[chunk + 1] || ftOut[chunk + 2] || ftOut[chunk + 3];
+    }
+
+    const auto [singleNs, singleSink] = timeLayers(*singleLayer);
+    const auto [stackNs, stackSink]   = timeLayers(*layerStack);
+
+    fmt::print("Single layer ({}x2->1):        {:>8.1f} ns/eval\n", HL_SIZE, singleNs);
+    fmt::print("Layer stack ({}x2->{}->{}->1): {:>8.1f} ns/eval\n", HL_SIZE, BENCH_L2, BENCH_L3, stackNs);
+    fmt::print("Non-zero input chunks:          {:>8.1f}%\n", nonzeroChunks * 100.0 / (boards.size() * HL_SIZE / 4));
+    fmt::print("Checksum: {}\n", singleSink ^ stackSink);
+}
+
+
+// EPD lines carry operations after the position, only the first four fields and any move counters are kept
+static string epdPosition(const string& line) {
+    const std::vector<string> tokens = split(line, ' ');
+
+    string fen = tokens[0] + " " + tokens[1] + " " + tokens[2] + " " + tokens[3];
+    for (usize i = 4; i < std::min<usize>(tokens.size(), 6); i++) {
+        if (tokens[i].empty() || !std::all_of(tokens[i].begin(), tokens[i].end(), ::isdigit))
+            break;
+        fen += " " + tokens[i];
+    }
+    return fen;
+}
+
+bool evalBatch(const string& inputPath, const string& outputPath, const usize threadCount) {
+    std::ifstream input(inputPath);
+    if (!input.is_open()) {
+        cerr << "Failed to open file: " + inputPath << endl;
+        return false;
+    }
+
+    std::vector<string> lines;
+    string              line;
+    // Counts blank lines too, so errors point at the line in the file
+    usize lineNumber = 0;
+    while (std::getline(input, line)) {
+        lineNumber++;
+        if (line.empty())
+            continue;
+        if (split(line, ' ').size() < 4) {
+            cerr << "Invalid position on line " << lineNumber << ": " << line << endl;
+            return false;
+        }
+        lines.push_back(line);
+    }
+
+    const auto network = nnue.get();
+
+    std::vector<string> fens(lines.size());
+    std::vector<i32>    evals(lines.size());
+
+    Stopwatch<std::chrono::milliseconds> time;
+
+    // Each thread parses and evaluates a contiguous slice
+    const auto evaluateSlice = [&](const usize begin, const usize end) {
+        std::vector<Board> boards(end - begin);
+        for (usize i = begin; i < end; i++) {
+            fens[i] = epdPosition(lines[i]);
+            boards[i - begin].reset();
+            boards[i - begin].loadFromFEN(fens[i]);
+        }
+        (*network)->evaluateBatch(boards, std::span(evals).subspan(begin, end - begin));
+    };
+
+    const usize              threads = std::clamp<usize>(threadCount, 1, std::max<usize>(lines.size(), 1));
+    std::vector<std::thread> workers;
+    for (usize t = 0; t < threads; t++)
+        workers.emplace_back(evaluateSlice, lines.size() * t / threads, lines.size() * (t + 1) / threads);
+    for (std::thread& worker : workers)
+        worker.join();
+
+    const u64 elapsed = std::max<u64>(time.elapsed(), 1);
+
+    std::ofstream output(outputPath);
+    if (!output.is_open()) {
+        cerr << "Failed to open file: " + outputPath << endl;
+        return false;
+    }
+    output << "fen,eval\n";
+    for (usize i = 0; i < fens.size(); i++)
+        output << fens[i] << "," << evals[i] << "\n";
+
+    fmt::print("Evaluated {} positions in {} with {} threads, {} positions per second\n", formatNum(fens.size()), formatTime(elapsed), threads, formatNum(fens.size() * 1000 / elapsed));
+    return output.good();
 }
\ No newline at end of file
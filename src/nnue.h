@@ -5,24 +5,309 @@
 #include "thread.h"
 #include "types.h"
 
+#include <algorithm>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+// Shape of a network that can be loaded at runtime
+template<usize HL_, usize BUCKETS_, int ACTIVATION_, usize L2_ = 0, usize L3_ = 0>
+struct NetworkArch {
+    static constexpr usize HL         = HL_;
+    static constexpr usize BUCKETS    = BUCKETS_;
+    static constexpr int   ACTIVATION = ACTIVATION_;
+    static constexpr usize L2         = L2_;
+    static constexpr usize L3         = L3_;
+};
+
+// A parent accumulator plus the weight rows of a pending update, summed as it is read so the child is never stored
+template<usize ADDS, usize SUBS>
+struct LazyAccumulator {
+    const i16*              parent;
+    array<const i16*, ADDS> addRows;
+    array<const i16*, SUBS> subRows;
+
+    i16 operator[](const usize i) const {
+        i16 value = parent[i];
+        for (const i16* row : addRows)
+            value += row[i];
+        for (const i16* row : subRows)
+            value -= row[i];
+        return value;
+    }
+};
+
+// Output of a single layer network, (HL)x2->1 per bucket
+// Input is either an Accumulator or a LazyAccumulator
+template<usize HL, usize BUCKETS, int ACTIVATION>
+struct SingleLayer {
+    alignas(64) MultiArray<i16, BUCKETS, HL * 2> weightsToOut;
+    array<i16, BUCKETS> outputBias;
+
+    // Size of the layer in a headerless network file
+    static constexpr usize RAW_SIZE = (BUCKETS * HL * 2 + BUCKETS) * sizeof(i16);
+
+    void load(std::istream& stream);
+
+    template<typename Input>
+    i32 vectorizedSCReLU(const Input& stm, const Input& nstm, usize bucket) const;
+    void vectorizedSCReLUBatch(const Accumulator* const* stm, const Accumulator* const* nstm, usize count, usize bucket, i64* output) const;
+
+    i32 dequantize(i64 eval, usize bucket) const;
+
+    template<typename Input>
+    i32 forward(const Input& stm, const Input& nstm, usize bucket) const;
+    // Up to EVAL_BATCH_SIZE positions in the same bucket, each weight is loaded once for all of them
+    void forwardBatch(const Accumulator* const* stm, const Accumulator* const* nstm, usize count, usize bucket, i32* output) const;
+};
+
+// Dense layer with i8 weights that only multiplies the columns of non-zero inputs
+template<usize IN, usize OUT, usize BUCKETS>
+struct SparseAffine {
+    // Indexed [bucket][input / 4][output][input % 4] so each group of 4 inputs reads one contiguous row
+    alignas(64) MultiArray<i8, BUCKETS, IN * OUT> weights;
+    alignas(64) MultiArray<float, BUCKETS, OUT> biases;
+
+    static constexpr usize RAW_SIZE = BUCKETS * IN * OUT * sizeof(i8) + BUCKETS * OUT * sizeof(float);
+
+    void load(std::istream& stream);
+
+    void forward(const u8* input, float* output, usize bucket) const;
+};
+
+// Dense layer with float weights
+template<usize IN, usize OUT, usize BUCKETS>
+struct Affine {
+    // Indexed [bucket][input][output]
+    alignas(64) MultiArray<float, BUCKETS, IN * OUT> weights;
+    alignas(64) MultiArray<float, BUCKETS, OUT> biases;
+
+    static constexpr usize RAW_SIZE = (BUCKETS * IN * OUT + BUCKETS * OUT) * sizeof(float);
+
+    void load(std::istream& stream);
+
+    void forward(const float* input, float* output, usize bucket) const;
+};
+
+// Output of a multi layer network, (HL)x2->L2->L3->1 per bucket
+template<usize HL, usize L2, usize L3, usize BUCKETS>
+struct LayerStack {
+    SparseAffine<HL, L2, BUCKETS> l1;
+    Affine<L2, L3, BUCKETS>       l2;
+    Affine<L3, 1, BUCKETS>        l3;
+
+    static constexpr usize RAW_SIZE = decltype(l1)::RAW_SIZE + decltype(l2)::RAW_SIZE + decltype(l3)::RAW_SIZE;
+
+    void load(std::istream& stream);
+
+    i32  forward(const Accumulator& stm, const Accumulator& nstm, usize bucket) const;
+    void forwardBatch(const Accumulator* const* stm, const Accumulator* const* nstm, usize count, usize bucket, i32* output) const;
+};
+
+template<typename Arch>
+using OutputLayers = std::conditional_t<(Arch::L2 > 0), LayerStack<Arch::HL, Arch::L2, Arch::L3, Arch::BUCKETS>, SingleLayer<Arch::HL, Arch::BUCKETS, Arch::ACTIVATION>>;
+
+// Weights of one architecture, laid out exactly as they are stored after the header of a network file
+template<typename Arch>
+struct NetworkWeights {
+    alignas(64) array<i16, Arch::HL * 768> weightsToHL;
+    alignas(64) array<i16, Arch::HL> hiddenLayerBias;
+    OutputLayers<Arch> output;
+
+    // Size of a headerless network file, the sections are packed without padding
+    static constexpr usize RAW_SIZE = (Arch::HL * 768 + Arch::HL) * sizeof(i16) + OutputLayers<Arch>::RAW_SIZE;
+
+    void loadNetwork(std::istream& stream);
+};
+
+using DefaultArch = NetworkArch<HL_SIZE, OUTPUT_BUCKETS, ACTIVATION, L2_SIZE, L3_SIZE>;
+
+// Secondary network for lopsided positions where precision matters less
+using SmallArch = NetworkArch<64, 8, SCReLU>;
+
+// Multi layer stack, (768->2048)x2->16->32->1x8
+using StackArch = NetworkArch<2048, 8, SCReLU, 16, 32>;
+
+// Every architecture a network file may use, the first one that matches a file is picked
+using NetworkArchs = std::tuple<DefaultArch, NetworkArch<512, 8, SCReLU>, NetworkArch<1536, 8, SCReLU>, StackArch, SmallArch>;
+
+// Largest hidden layer of any architecture, sizes accumulators that are not tied to a loaded network
+constexpr usize MAX_HL_SIZE = std::apply([](const auto... archs) { return std::max({ decltype(archs)::HL... }); }, NetworkArchs{});
+
+constexpr array<char, 8> NETWORK_MAGIC   = { 'L', 'Z', 'R', 'S', 'N', 'N', 'U', 'E' };
+constexpr u32            NETWORK_VERSION = 1;
+
+// Start of a network file, the weights follow at headerSize bytes with the same layout and padding as NetworkWeights
+struct NetworkHeader {
+    array<char, 8> magic;
+    u32            version;
+    u32            headerSize;
+    u32            inputSize;
+    u32            hlSize;
+    u32            l2Size;
+    u32            l3Size;
+    u32            outputBuckets;
+    u32            activation;
+    i32            qa;
+    i32            qb;
+    i32            evalScale;
+    i32            ftShift;
+    i32            l1Q;
+    u32            padding;
+    u64            payloadSize;
+    u64            hash;
+
+    // Header describing a network of the given architecture
+    template<typename Arch>
+    static NetworkHeader of();
+};
+
+// Aligned so the weights after the header are aligned when the file is mapped
+constexpr usize NETWORK_HEADER_SIZE = (sizeof(NetworkHeader) + 63) / 64 * 64;
+
+// Inference for whichever architecture was loaded, the accumulators are only valid for the network that built them
 struct NNUE {
-    alignas(64) array<i16, HL_SIZE * 768> weightsToHL;
-    alignas(64) array<i16, HL_SIZE> hiddenLayerBias;
-    alignas(64) MultiArray<i16, OUTPUT_BUCKETS, HL_SIZE * 2> weightsToOut;
-    array<i16, OUTPUT_BUCKETS> outputBias;
+    NetworkHeader header;
+
+    explicit NNUE(const NetworkHeader& header) :
+        header(header) {}
+    virtual ~NNUE() = default;
 
     static i16 ReLU(i16 x);
     static i16 CReLU(i16 x);
     static i32 SCReLU(i16 x);
 
-    i32 vectorizedSCReLU(const Accumulator& stm, const Accumulator& nstm, usize bucket) const;
+    template<usize BUCKETS>
+    static usize outputBucket(const Board* board);
+
+    virtual void refresh(const Board& board, AccumulatorPair& accumulators) const = 0;
+    // Write the child's values from its parent and pending update
+    virtual void apply(const AccumulatorPair& parent, AccumulatorPair& child) const = 0;
+    // Start loading the weights an update will read, before the move is made
+    virtual void prefetch(const AccumulatorUpdate& update) const = 0;
+
+    virtual int  forwardPass(const Board* board, const AccumulatorPair& accumulators) const = 0;
+    // Output of the child, computed from its parent and pending update without writing it
+    virtual int  forwardPassLazy(const Board* board, const AccumulatorPair& parent, const AccumulatorUpdate& update) const = 0;
+    virtual void showBuckets(const Board* board, const AccumulatorPair& accumulators) const = 0;
+
+    // Raw outputs of many positions, without a search or accumulator stack
+    virtual void evaluateBatch(std::span<const Board> boards, std::span<i32> evals) const = 0;
+
+    // Raw weights, as written after the header
+    virtual const u8* data() const = 0;
+    virtual bool      ownsWeights() const = 0;
+
+    usize hlSize() const {
+        return header.hlSize;
+    }
+
+    // Write the accumulator at idx, applying the pending updates forward from the last written ply below it
+    void applyPendingUpdates(AccumulatorStack& accumulatorStack, usize idx) const;
+
+    // Raw output for the top of the stack, writing the top accumulator if it is still pending
+    int evaluate(const Board& board, AccumulatorStack& accumulatorStack) const;
+    // For leaves that are unlikely to be searched further, only the parent is written and the top stays pending
+    int evaluateLeaf(const Board& board, AccumulatorStack& accumulatorStack) const;
+};
+
+template<typename Arch>
+class NNUEImpl final : public NNUE {
+    const NetworkWeights<Arch>*           weights;
+    std::unique_ptr<NetworkWeights<Arch>> owned;
+
+   public:
+    // Either points at mapped weights or takes ownership of a copy
+    explicit NNUEImpl(const NetworkWeights<Arch>* weights);
+    explicit NNUEImpl(std::unique_ptr<NetworkWeights<Arch>> owned);
+
+    void refresh(const Board& board, AccumulatorPair& accumulators) const override;
+    void apply(const AccumulatorPair& parent, AccumulatorPair& child) const override;
+    void prefetch(const AccumulatorUpdate& update) const override;
+
+    int  forwardPass(const Board* board, const AccumulatorPair& accumulators) const override;
+    int  forwardPassLazy(const Board* board, const AccumulatorPair& parent, const AccumulatorUpdate& update) const override;
+    void showBuckets(const Board* board, const AccumulatorPair& accumulators) const override;
+
+    void evaluateBatch(std::span<const Board> boards, std::span<i32> evals) const override;
+
+    template<usize ADDS, usize SUBS>
+    int forwardPassLazy(const Board* board, const AccumulatorPair& parent, const AccumulatorUpdate& update) const;
+
+    const u8* data() const override {
+        return reinterpret_cast<const u8*>(weights);
+    }
+    bool ownsWeights() const override {
+        return owned != nullptr;
+    }
+};
+
+// Owns the memory behind a network, either a read only mapping of the file or an aligned copy of headerless weights
+class Network {
+    std::unique_ptr<NNUE> impl;
+    const u8*             mapping     = nullptr;
+    usize                 mappingSize = 0;
+
+    bool load(const u8* data, usize size);
+    void unmap();
+
+   public:
+    Network() = default;
+    ~Network();
+
+    Network(const Network& other)            = delete;
+    Network& operator=(const Network& other) = delete;
+    Network(Network&& other) noexcept;
+    Network& operator=(Network&& other) noexcept;
+
+    // Return false and leave the network untouched if the data is not a valid network for this engine
+    bool loadFile(const string& filepath);
+    bool loadMemory(const u8* data, usize size);
+
+    bool save(const string& filepath) const;
+
+    bool isMapped() const {
+        return mapping != nullptr && !impl->ownsWeights();
+    }
+
+    const NNUE* operator->() const {
+        return impl.get();
+    }
+    const NNUE& operator*() const {
+        return *impl;
+    }
+};
+
+// The network new searches start with
+// Swapping it never touches the weights a running search uses, each search holds a reference to the network it started with
+class NetworkSlot {
+    mutable std::mutex             lock;
+    std::shared_ptr<const Network> current;
+    std::thread                    loader;
+
+   public:
+    NetworkSlot() = default;
+    ~NetworkSlot();
+
+    std::shared_ptr<const Network> get() const;
 
-    static usize feature(Color perspective, Color color, PieceType piece, Square square);
+    // Drop the current network, searches that already hold it keep using it
+    void clear();
 
-    void loadNetwork(const string& filepath);
+    // Returns false and keeps the current network if loadNetwork fails
+    bool load(const std::function<bool(Network&)>& loadNetwork);
+    // Same as load, but on a background thread so searches carry on with the current network until it finishes
+    void loadAsync(std::function<bool(Network&)> loadNetwork);
+    void waitForLoad();
+};
 
-    int  forwardPass(const Board* board, const AccumulatorPair& accumulators) const;
-    void showBuckets(const Board* board, const AccumulatorPair& accumulators) const;
+// Compares the cost of the single layer output against a multi layer stack
+void evalBench();
 
-    i16 evaluate(const Board& board, const ThreadData& thisThread) const;
-};
\ No newline at end of file
+// Writes the raw eval of every position in an EPD file to a CSV file
+bool evalBatch(const string& inputPath, const string& outputPath, usize threadCount);
\ No newline at end of file
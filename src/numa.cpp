@@ -0,0 +1,142 @@
+#include "numa.h"
+#include "util.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#ifdef __linux__
+    #include <sched.h>
+#endif
+
+namespace Numa {
+static Policy policy = Policy::AUTO;
+
+struct Node {
+    std::vector<usize> cpus;       // Every usable CPU of the node
+    std::vector<usize> coreOrder;  // The same CPUs, one per physical core before any SMT sibling
+};
+
+// Parse a sysfs CPU list such as "0-3,8-11"
+static std::vector<usize> parseCpuList(const string& list) {
+    std::vector<usize> cpus;
+    for (const string& range : split(list, ',')) {
+        if (range.empty())
+            continue;
+        const usize dash  = range.find('-');
+        const usize first = std::stoull(range.substr(0, dash));
+        const usize last  = dash == string::npos ? first : std::stoull(range.substr(dash + 1));
+        for (usize cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+static string readLine(const string& path) {
+    std::ifstream file(path);
+    string        line;
+    std::getline(file, line);
+    return line;
+}
+
+static std::vector<Node> detect() {
+    std::vector<Node> nodes;
+#ifdef __linux__
+    // CPUs outside the affinity mask, for example from cgroups or taskset, are never used
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return nodes;
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+        const string name = entry.path().filename().string();
+        if (!name.starts_with("node") || name.size() == 4 || !std::all_of(name.begin() + 4, name.end(), ::isdigit))
+            continue;
+
+        Node node;
+        for (const usize cpu : parseCpuList(readLine(entry.path().string() + "/cpulist")))
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                node.cpus.push_back(cpu);
+        if (node.cpus.empty())
+            continue;
+
+        // The lowest sibling stands for the physical core
+        std::vector<usize> firstSiblings;
+        std::vector<usize> laterSiblings;
+        for (const usize cpu : node.cpus) {
+            const std::vector<usize> siblings = parseCpuList(readLine("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list"));
+            const bool               isFirst  = siblings.empty() || cpu == *std::ranges::min_element(siblings);
+            (isFirst ? firstSiblings : laterSiblings).push_back(cpu);
+        }
+        node.coreOrder = firstSiblings;
+        node.coreOrder.insert(node.coreOrder.end(), laterSiblings.begin(), laterSiblings.end());
+
+        nodes.push_back(node);
+    }
+#endif
+    return nodes;
+}
+
+static const std::vector<Node>& topology() {
+    static const std::vector<Node> nodes = detect();
+    return nodes;
+}
+
+bool setPolicy(const string& name) {
+    if (name == "none")
+        policy = Policy::NONE;
+    else if (name == "auto")
+        policy = Policy::AUTO;
+    else if (name == "nosmt")
+        policy = Policy::NO_SMT;
+    else {
+        cerr << "Unknown NUMA policy " << name << endl;
+        return false;
+    }
+    return true;
+}
+
+usize nodeCount() {
+    return std::max<usize>(topology().size(), 1);
+}
+
+bool active(const usize threadCount) {
+    const std::vector<Node>& nodes = topology();
+    if (nodes.empty() || threadCount <= 1)
+        return false;
+    if (policy == Policy::NO_SMT)
+        return true;
+
+    const usize largestNode = std::ranges::max(nodes, {}, [](const Node& node) { return node.cpus.size(); }).cpus.size();
+    return policy == Policy::AUTO && nodes.size() > 1 && threadCount > largestNode;
+}
+
+void bindThread(const usize threadId, const usize threadCount) {
+#ifdef __linux__
+    if (!active(threadCount))
+        return;
+
+    // Threads fill the nodes in equal consecutive blocks, so threads next to each other share a node
+    const std::vector<Node>& nodes = topology();
+    const usize              index = threadId * nodes.size() / std::max<usize>(threadCount, 1);
+    const Node&              node  = nodes[index];
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (policy == Policy::NO_SMT) {
+        // Position of the thread inside its node's block picks its core
+        const usize firstInNode = (index * threadCount + nodes.size() - 1) / nodes.size();
+        CPU_SET(node.coreOrder[(threadId - firstInNode) % node.coreOrder.size()], &cpus);
+    }
+    else
+        for (const usize cpu : node.cpus)
+            CPU_SET(cpu, &cpus);
+
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+#else
+    (void) threadId;
+    (void) threadCount;
+#endif
+}
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "types.h"
+
+namespace Numa {
+// None never binds, auto binds when the threads do not fit on one node, nosmt binds any search with more than one thread
+// and puts threads on separate cores first
+// A lone thread is left to the scheduler, pinning it would put the same thread of every engine process on the same CPUs
+enum class Policy { NONE, AUTO, NO_SMT };
+
+// Returns false and keeps the current policy if the name is unknown
+bool setPolicy(const string& name);
+
+// Number of NUMA nodes with CPUs this process may use, 1 without topology information
+usize nodeCount();
+
+// Whether a search with this many threads is bound under the current policy
+bool active(usize threadCount);
+
+// Bind the calling thread to the CPUs of the node the thread index is assigned to, does nothing when inactive
+void bindThread(usize threadId, usize threadCount);
+}
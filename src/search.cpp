@@ -5,9 +5,13 @@
 #include "globals.h"
 #include "movegen.h"
 #include "movepicker.h"
+#include "numa.h"
 #include "searcher.h"
+#include "tablebase.h"
 #include "thread.h"
+#include "timeman.h"
 
+#include <chrono>
 #include <cmath>
 
 const auto lmrTable = []() {
@@ -32,10 +36,70 @@ const auto lmrTable = []() {
     return lmrTable;
 }();
 
+// Quiets tried at each depth before the rest are pruned, indexed [improving][depth]
+const auto lmpTable = []() {
+    MultiArray<int, 2, LMP_MAX_DEPTH + 1> lmpTable;
+    for (int improving = 0; improving <= 1; improving++)
+        for (int depth = 0; depth <= LMP_MAX_DEPTH; depth++)
+            lmpTable[improving][depth] = (LMP_BASE + depth * depth) / (2 - improving);
+    return lmpTable;
+}();
+
+const array<string, 50> BENCH_FENS = { "r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w KQkq a6 0 14",
+                                       "4rrk1/2p1b1p1/p1p3q1/4p3/2P2n1p/1P1NR2P/PB3PP1/3R1QK1 b - - 2 24",
+                                       "r3qbrk/6p1/2b2pPp/p3pP1Q/PpPpP2P/3P1B2/2PB3K/R5R1 w - - 16 42",
+                                       "6k1/1R3p2/6p1/2Bp3p/3P2q1/P7/1P2rQ1K/5R2 b - - 4 44",
+                                       "8/8/1p2k1p1/3p3p/1p1P1P1P/1P2PK2/8/8 w - - 3 54",
+                                       "7r/2p3k1/1p1p1qp1/1P1Bp3/p1P2r1P/P7/4R3/Q4RK1 w - - 0 36",
+                                       "r1bq1rk1/pp2b1pp/n1pp1n2/3P1p2/2P1p3/2N1P2N/PP2BPPP/R1BQ1RK1 b - - 2 10",
+                                       "3r3k/2r4p/1p1b3q/p4P2/P2Pp3/1B2P3/3BQ1RP/6K1 w - - 3 87",
+                                       "2r4r/1p4k1/1Pnp4/3Qb1pq/8/4BpPp/5P2/2RR1BK1 w - - 0 42",
+                                       "4q1bk/6b1/7p/p1p4p/PNPpP2P/KN4P1/3Q4/4R3 b - - 0 37",
+                                       "2q3r1/1r2pk2/pp3pp1/2pP3p/P1Pb1BbP/1P4Q1/R3NPP1/4R1K1 w - - 2 34",
+                                       "1r2r2k/1b4q1/pp5p/2pPp1p1/P3Pn2/1P1B1Q1P/2R3P1/4BR1K b - - 1 37",
+                                       "r3kbbr/pp1n1p1P/3ppnp1/q5N1/1P1pP3/P1N1B3/2P1QP2/R3KB1R b KQkq b3 0 17",
+                                       "8/6pk/2b1Rp2/3r4/1R1B2PP/P5K1/8/2r5 b - - 16 42",
+                                       "1r4k1/4ppb1/2n1b1qp/pB4p1/1n1BP1P1/7P/2PNQPK1/3RN3 w - - 8 29",
+                                       "8/p2B4/PkP5/4p1pK/4Pb1p/5P2/8/8 w - - 29 68",
+                                       "3r4/ppq1ppkp/4bnp1/2pN4/2P1P3/1P4P1/PQ3PBP/R4K2 b - - 2 20",
+                                       "5rr1/4n2k/4q2P/P1P2n2/3B1p2/4pP2/2N1P3/1RR1K2Q w - - 1 49",
+                                       "1r5k/2pq2p1/3p3p/p1pP4/4QP2/PP1R3P/6PK/8 w - - 1 51",
+                                       "q5k1/5ppp/1r3bn1/1B6/P1N2P2/BQ2P1P1/5K1P/8 b - - 2 34",
+                                       "r1b2k1r/5n2/p4q2/1ppn1Pp1/3pp1p1/NP2P3/P1PPBK2/1RQN2R1 w - - 0 22",
+                                       "r1bqk2r/pppp1ppp/5n2/4b3/4P3/P1N5/1PP2PPP/R1BQKB1R w KQkq - 0 5",
+                                       "r1bqr1k1/pp1p1ppp/2p5/8/3N1Q2/P2BB3/1PP2PPP/R3K2n b Q - 1 12",
+                                       "r1bq2k1/p4r1p/1pp2pp1/3p4/1P1B3Q/P2B1N2/2P3PP/4R1K1 b - - 2 19",
+                                       "r4qk1/6r1/1p4p1/2ppBbN1/1p5Q/P7/2P3PP/5RK1 w - - 2 25",
+                                       "r7/6k1/1p6/2pp1p2/7Q/8/p1P2K1P/8 w - - 0 32",
+                                       "r3k2r/ppp1pp1p/2nqb1pn/3p4/4P3/2PP4/PP1NBPPP/R2QK1NR w KQkq - 1 5",
+                                       "3r1rk1/1pp1pn1p/p1n1q1p1/3p4/Q3P3/2P5/PP1NBPPP/4RRK1 w - - 0 12",
+                                       "5rk1/1pp1pn1p/p3Brp1/8/1n6/5N2/PP3PPP/2R2RK1 w - - 2 20",
+                                       "8/1p2pk1p/p1p1r1p1/3n4/8/5R2/PP3PPP/4R1K1 b - - 3 27",
+                                       "8/4pk2/1p1r2p1/p1p4p/Pn5P/3R4/1P3PP1/4RK2 w - - 1 33",
+                                       "8/5k2/1pnrp1p1/p1p4p/P6P/4R1PK/1P3P2/4R3 b - - 1 38",
+                                       "8/8/1p1kp1p1/p1pr1n1p/P6P/1R4P1/1P3PK1/1R6 b - - 15 45",
+                                       "8/8/1p1k2p1/p1prp2p/P2n3P/6P1/1P1R1PK1/4R3 b - - 5 49",
+                                       "8/8/1p4p1/p1p2k1p/P2n1P1P/4K1P1/1P6/3R4 w - - 6 54",
+                                       "8/8/1p4p1/p1p2k1p/P2n1P1P/4K1P1/1P6/6R1 b - - 6 59",
+                                       "8/5k2/1p4p1/p1pK3p/P2n1P1P/6P1/1P6/4R3 b - - 14 63",
+                                       "8/1R6/1p1K1kp1/p6p/P1p2P1P/6P1/1Pn5/8 w - - 0 67",
+                                       "1rb1rn1k/p3q1bp/2p3p1/2p1p3/2P1P2N/PP1RQNP1/1B3P2/4R1K1 b - - 4 23",
+                                       "4rrk1/pp1n1pp1/q5p1/P1pP4/2n3P1/7P/1P3PB1/R1BQ1RK1 w - - 3 22",
+                                       "r2qr1k1/pb1nbppp/1pn1p3/2ppP3/3P4/2PB1NN1/PP3PPP/R1BQR1K1 w - - 4 12",
+                                       "2r2k2/8/4P1R1/1p6/8/P4K1N/7b/2B5 b - - 0 55",
+                                       "6k1/5pp1/8/2bKP2P/2P5/p4PNb/B7/8 b - - 1 44",
+                                       "2rqr1k1/1p3p1p/p2p2p1/P1nPb3/2B1P3/5P2/1PQ2NPP/R1R4K w - - 3 25",
+                                       "r1b2rk1/p1q1ppbp/6p1/2Q5/8/4BP2/PPP3PP/2KR1B1R b - - 2 14",
+                                       "6r1/5k2/p1b1r2p/1pB1p1p1/1Pp3PP/2P1R1K1/2P2P2/3R4 w - - 1 36",
+                                       "rnbqkb1r/pppppppp/5n2/8/2PP4/8/PP2PPPP/RNBQKBNR b KQkq c3 0 2",
+                                       "2rr2k1/1p4bp/p1q1p1p1/4Pp1n/2PB4/1PN3P1/P3Q2P/2RR2K1 w - f6 0 20",
+                                       "3br1k1/p1pn3p/1p3n2/5pNq/2P1p3/1PN3PP/P2Q1PB1/4R1K1 w - - 0 23",
+                                       "2r2b2/5p2/5k2/p1r1pP2/P2pB3/1P3P2/K1P3R1/7R w - - 23 93" };
+
 // Quiescence search
 template<NodeType isPV>
 i16 qsearch(Board& board, const usize ply, i16 alpha, const i16 beta, ThreadData& thisThread) {
-    const i16 staticEval = nnue.evaluate(board, thisThread);
+    const i16 staticEval = thisThread.evaluateLeaf(board);
     if (ply >= MAX_PLY)
         return staticEval;
 
@@ -47,13 +111,16 @@ i16 qsearch(Board& board, const usize ply, i16 alpha, const i16 beta, ThreadData
 
     i16 futilityScore = bestScore + QS_FUTILITY_MARGIN;
 
-    Movepicker<NOISY_ONLY> picker(board, thisThread, Move::null());
+    Movepicker<NOISY_ONLY> picker(board, thisThread, nullptr, Move::null(), thisThread.plyArena.at(ply));
     while (picker.hasNext()) {
         const Move m = picker.getNext();
 
         if (!board.isLegal(m))
             continue;
 
+        thisThread.evalCache.prefetch(board.roughKeyAfter(m));
+        thisThread.prefetchNetwork(board, m);
+
         if (!board.see(m, 0))
             continue;
 
@@ -84,7 +151,7 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
     if (depth + static_cast<i16>(ply) > static_cast<i16>(MAX_PLY))
         depth = MAX_PLY - ply;
     if constexpr (isPV)
-        ss->pv.length = 0;
+        thisThread.plyArena.at(ply).pv.length = 0;
     if (ply > thisThread.seldepth)
         thisThread.seldepth = ply;
     if (board.isDraw() && ply > 0)
@@ -110,7 +177,7 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
     TTFlag ttFlag = FAIL_LOW;
 
     // TT probing
-    Transposition& ttEntry = tt.getEntry(board.fullHash);
+    Transposition& ttEntry = thisThread.getTTEntry(tt, board.fullHash);
     const bool     ttHit   = ss->excluded.isNull() && ttEntry.key == board.fullHash;
 
     if (!isPV && ttHit && ttEntry.depth >= depth &&
@@ -126,7 +193,55 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
         return ttScore;
     }
 
-    ss->staticEval = thisThread.correctStaticEval(board, nnue.evaluate(board, thisThread));
+    // Tablebase probing
+    i16 maxScore = INF_I16;
+    if (ply > 0 && ss->excluded.isNull() && depth >= static_cast<i16>(SYZYGY_PROBE_DEPTH) && Tablebase::canProbeWDL(board)
+        && (SYZYGY_PROBES_PER_DEPTH == 0 || thisThread.tbStats.probesAtDepth[depth] < SYZYGY_PROBES_PER_DEPTH)) {
+        const auto           probeStart = std::chrono::steady_clock::now();
+        const Tablebase::WDL wdl        = Tablebase::probeWDL(board);
+
+        thisThread.tbStats.probes++;
+        thisThread.tbStats.probesAtDepth[depth]++;
+        thisThread.tbStats.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - probeStart).count();
+
+        if (wdl != Tablebase::WDL::FAILED) {
+            thisThread.tbHits.fetch_add(1, std::memory_order_relaxed);
+
+            i16    score;
+            TTFlag flag;
+            if (wdl == Tablebase::WDL::WIN) {
+                score = TB_WIN_SCORE - ply;
+                flag  = BETA_CUTOFF;
+            }
+            else if (wdl == Tablebase::WDL::LOSS) {
+                score = -TB_WIN_SCORE + ply;
+                flag  = FAIL_LOW;
+            }
+            else {
+                score = 0;
+                flag  = EXACT;
+            }
+
+            if (flag == EXACT || (flag == BETA_CUTOFF && score >= beta) || (flag == FAIL_LOW && score <= alpha)) {
+                // Stored deeper than any search could reach, the result is exact
+                const i16 storedScore = isWin(score) ? score + ply : isLoss(score) ? score - ply : score;
+                thisThread.storeTTEntry(ttEntry, Transposition(board.fullHash, Move::null(), flag, storedScore, std::min<usize>(depth + 6, MAX_PLY)));
+                return score;
+            }
+
+            // PV nodes keep searching for the fastest win or longest loss within the known bound
+            if constexpr (isPV) {
+                if (flag == BETA_CUTOFF) {
+                    bestScore = score;
+                    alpha     = std::max(alpha, score);
+                }
+                else
+                    maxScore = score;
+            }
+        }
+    }
+
+    ss->staticEval = thisThread.correctStaticEval(board, thisThread.evaluate(board));
 
     // Has the current position improving since last time stm played
     const bool improving = ss->staticEval > (ss - 2)->staticEval;
@@ -142,6 +257,8 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
         if (board.canNullMove() && ss->staticEval >= beta) {
             const i16 reduction = NMP_DEPTH_REDUCTION;
 
+            ss->movedPiece = NO_PIECE_TYPE;
+
             auto [newBoard, threadManager] = thisThread.makeNullMove(board);
             const i16 score                = -search<NONPV>(newBoard, depth - reduction, ply + 1, -beta, -beta + 1, ss + 1, thisThread, tt, sl);
 
@@ -152,41 +269,89 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
 
     bool skipQuiets = false;
 
-    MoveList badQuiets{};
-    MoveList badNoisies{};
+    // Children start with no killer, the killers of an unrelated earlier subtree are rarely good ordering
+    (ss + 1)->killer = Move::null();
+
+    PlyData&  plyData    = thisThread.plyArena.at(ply, !ss->excluded.isNull());
+    MoveList& badQuiets  = plyData.badQuiets;
+    MoveList& badNoisies = plyData.badNoisies;
+    badQuiets.length     = 0;
+    badNoisies.length    = 0;
+
+    // ABDADA: moves another thread was already searching, tried once the others are done
+    MoveList& deferred    = plyData.deferred;
+    usize     deferredIdx = 0;
+    deferred.length       = 0;
+
+    Movepicker<ALL_MOVES> picker(board, thisThread, ss, ttHit ? ttEntry.move : Move::null(), plyData);
+    while (picker.hasNext() || deferredIdx < deferred.length) {
+        // Deterministic SMP waits for the other threads at the end of every epoch
+        if (thisThread.nodes >= thisThread.nextEpoch)
+            thisThread.syncEpoch();
 
-    Movepicker<ALL_MOVES> picker(board, thisThread, ttHit ? ttEntry.move : Move::null());
-    while (picker.hasNext()) {
         // Check if the search has been aborted
-        if (thisThread.breakFlag.load(std::memory_order_relaxed))
+        if (thisThread.stopRequested())
             return bestScore;
         if (sl.outOfNodes(thisThread.nodes)) {
-            thisThread.breakFlag.store(true, std::memory_order_relaxed);
+            thisThread.requestStop();
             return bestScore;
         }
-        if (thisThread.nodes % 2048 == 0 && sl.outOfTime()) {
-            thisThread.breakFlag.store(true, std::memory_order_relaxed);
+        if (thisThread.nodes % 2048 == 0 && sl.outOfTime(thisThread.nodes)) {
+            thisThread.requestStop();
             return bestScore;
         }
 
-        const Move m = picker.getNext();
+        const bool isDeferred = !picker.hasNext();
+        const Move m          = isDeferred ? deferred.moves[deferredIdx++] : picker.getNext();
 
         if (m == ss->excluded)
             continue;
 
+        RootMove* rootMove = nullptr;
+        if (ply == 0) {
+            const auto it = std::ranges::find(thisThread.rootMoves.begin() + thisThread.pvIdx, thisThread.rootMoves.end(), m, &RootMove::move);
+            if (it == thisThread.rootMoves.end())
+                continue;
+            rootMove = &*it;
+        }
+
         if (!board.isLegal(m))
             continue;
 
         if (board.isQuiet(m) && skipQuiets)
             continue;
 
+        const u64  keyAfter = board.roughKeyAfter(m);
+        const bool useBusy  = thisThread.busyTable != nullptr && depth >= ABDADA_MIN_DEPTH;
+
+        // The first move is always searched, later ones another thread is busy with wait until the end
+        if (useBusy && !isDeferred && movesSeen > 0 && thisThread.busyTable->isBusy(keyAfter)) {
+            deferred.add(m);
+            continue;
+        }
+
         movesSeen++;
 
-        // TT prefetching
-        tt.prefetch(board.roughKeyAfter(m));
+        // TT, eval cache, correction history and network weight prefetching
+        tt.prefetch(keyAfter);
+        thisThread.evalCache.prefetch(keyAfter);
+        thisThread.prefetch(board, m);
+
+        // History the move was ordered by, drives history pruning and LMR
+        const i32 moveHistory = board.isQuiet(m) ? thisThread.getQuietHistory(board, ss, m) : static_cast<i32>(thisThread.getCaptureHistory(board, m));
 
         // Moveloop pruning
         if (ply > 0 && !isLoss(bestScore)) {
+            // Late move pruning
+            if (depth <= LMP_MAX_DEPTH && movesSeen >= lmpTable[improving][depth])
+                skipQuiets = true;
+            if (skipQuiets && board.isQuiet(m))
+                continue;
+
+            // History pruning
+            if (depth <= HIST_PRUNING_MAX_DEPTH && board.isQuiet(m) && moveHistory < -HIST_PRUNING_SCALAR * depth)
+                continue;
+
             // Futility pruning
             if (!board.inCheck() && depth < 6 && board.isQuiet(m) && ss->staticEval + FUTILITY_PRUNING_MARGIN + FUTILITY_PRUNING_SCALAR * depth < alpha) {
                 skipQuiets = true;
@@ -222,18 +387,29 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
                 extension = -2;
         }
 
+        const u64 nodesBefore = thisThread.nodes.load(std::memory_order_relaxed);
+
+        ss->movedPiece = board.getPiece(m.from());
+        ss->movedTo    = m.to();
+
         auto [newBoard, threadManager] = thisThread.makeMove(board, m);
         thisThread.nodes.fetch_add(1, std::memory_order_relaxed);
 
+        if (useBusy)
+            thisThread.busyTable->enter(keyAfter);
+
         const i16 newDepth = depth - 1 + extension;
 
         // Principal variation search (PVS)
         i16 score = -INF_I16;
         if (depth >= 2 && movesSearched >= 5 + 2 * (ply == 0) && !newBoard.inCheck()) {
             // Late move reduction (LMR)
-            const i16 depthReduction = lmrTable[board.isQuiet(m)][depth][movesSearched] + !isPV * LMR_NONPV;
+            i32 depthReduction = lmrTable[board.isQuiet(m)][depth][movesSearched] + !isPV * LMR_NONPV - (m == ss->killer) * LMR_KILLER + thisThread.lmrOffset;
+            depthReduction -= moveHistory * 1024 / LMR_HISTORY_DIVISOR;
+            // Good history can make the reduction negative, the reduced search never goes past the full depth one
+            const i16 reducedDepth = std::clamp<i16>(newDepth - depthReduction / 1024, 1, newDepth);
 
-            score = -search<NONPV>(newBoard, newDepth - depthReduction / 1024, ply + 1, -alpha - 1, -alpha, ss + 1, thisThread, tt, sl);
+            score = -search<NONPV>(newBoard, reducedDepth, ply + 1, -alpha - 1, -alpha, ss + 1, thisThread, tt, sl);
 
             if (score > alpha)
                 score = -search<NONPV>(newBoard, newDepth, ply + 1, -alpha - 1, -alpha, ss + 1, thisThread, tt, sl);
@@ -243,6 +419,12 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
         if (isPV && (movesSearched == 1 || score > alpha))
             score = -search<PV>(newBoard, newDepth, ply + 1, -beta, -alpha, ss + 1, thisThread, tt, sl);
 
+        if (useBusy)
+            thisThread.busyTable->leave(keyAfter);
+
+        if (ply == 0)
+            rootMove->nodes += thisThread.nodes.load(std::memory_order_relaxed) - nodesBefore;
+
         if (score > bestScore) {
             bestScore = score;
             if (bestScore > alpha) {
@@ -250,7 +432,7 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
                 ttFlag   = EXACT;
                 alpha    = bestScore;
                 if constexpr (isPV)
-                    ss->pv.update(m, (ss + 1)->pv);
+                    plyData.pv.update(m, thisThread.plyArena.at(ply + 1).pv);
             }
         }
         if (score >= beta) {
@@ -258,12 +440,14 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
 
             // Update histories
             const i32 historyBonus = (HIST_BONUS_A * depth * depth + HIST_BONUS_B * depth + HIST_BONUS_C) / 1024;
-            if (board.isQuiet(m))
-                thisThread.getHistory(board, m).update(historyBonus);
+            if (board.isQuiet(m)) {
+                thisThread.updateQuietHistory(board, ss, m, historyBonus);
+                ss->killer = m;
+            }
             else
                 thisThread.getCaptureHistory(board, m).update(historyBonus);
             for (const Move badQuiet : badQuiets)
-                thisThread.getHistory(board, badQuiet).update(-historyBonus);
+                thisThread.updateQuietHistory(board, ss, badQuiet, -historyBonus);
             for (const Move badNoisy : badNoisies)
                 thisThread.getCaptureHistory(board, badNoisy).update(-historyBonus);
 
@@ -286,6 +470,8 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
         return 0;
     }
 
+    bestScore = std::min(bestScore, maxScore);
+
     // Adjust TT score for mates
     i16 ttScore = bestScore;
     if (isLoss(bestScore))
@@ -293,7 +479,8 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
     else if (isWin(bestScore))
         ttScore = bestScore + static_cast<i16>(ply);
 
-    if (ss->excluded.isNull() && !thisThread.breakFlag.load(std::memory_order_relaxed)) {
+    // Later MultiPV lines exclude the better root moves, their root score is not the position's
+    if (ss->excluded.isNull() && !thisThread.stopRequested() && (ply > 0 || thisThread.pvIdx == 0)) {
         // Update correction histories
         if (!board.inCheck() && (board.isQuiet(bestMove) || bestMove.isNull()) && (ttFlag == EXACT || ttFlag == BETA_CUTOFF && bestScore > ss->staticEval || ttFlag == FAIL_LOW && bestScore < ss->staticEval))
             thisThread.updateCorrhist(board, depth, bestScore, ss->staticEval);
@@ -302,33 +489,40 @@ i16 search(Board& board, i16 depth, const usize ply, i16 alpha, i16 beta, Search
         const Transposition newEntry(board.fullHash, bestMove, ttFlag, ttScore, depth);
 
         if (tt.shouldReplace(ttEntry, newEntry))
-            ttEntry = newEntry;
+            thisThread.storeTTEntry(ttEntry, newEntry);
     }
 
     return bestScore;
 }
 
+// Helper threads skip depths in staggered patterns, so they run ahead of the main thread on different iterations
+constexpr array<usize, 20> SKIP_SIZE  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+constexpr array<usize, 20> SKIP_PHASE = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
+static bool skipDepth(const usize threadId, const usize depth) {
+    // ABDADA threads split the moves of the same iteration instead
+    if (threadId == 0 || ABDADA)
+        return false;
+    const usize pattern = (threadId - 1) % SKIP_SIZE.size();
+    return (depth + SKIP_PHASE[pattern]) / SKIP_SIZE[pattern] % 2 != 0;
+}
+
 MoveEvaluation Searcher::iterativeDeepening(ThreadData& thisThread, Board board, SearchParams sp) {
-    thisThread.breakFlag.store(false);
+    Numa::bindThread(thisThread.threadId, threadData.size());
+
     thisThread.nodes    = 0;
+    thisThread.tbHits   = 0;
+    thisThread.tbStats  = {};
     thisThread.seldepth = 0;
     thisThread.refresh(board);
     const bool isMain = thisThread.type == ThreadType::MAIN;
 
     // Time management
-    const i64 time = board.stm == WHITE ? sp.wtime : sp.btime;
-    const i64 inc  = board.stm == WHITE ? sp.winc : sp.binc;
-
-    i64 searchTime = sp.mtime ? sp.mtime : (time / 20 + inc / 2);
-
-    if (time != 0 || inc != 0)
-        searchTime = std::max<i64>(searchTime - static_cast<i64>(MOVE_OVERHEAD), 1);
-
-    const i64 softTime = searchTime * 0.6;
+    TimeManager timeManager(sp, board.stm);
 
     // Create search limits, excluding time for depth 1
-    SearchLimit depthOneSl(sp.time, 0, sp.nodes);
-    SearchLimit mainSl(sp.time, searchTime, sp.nodes);
+    SearchLimit depthOneSl(sp.time, 0, sp.nodes, pondering);
+    SearchLimit mainSl(sp.time, timeManager.hardLimit(), sp.nodes, pondering);
 
     // Create the search stack and clear it
     auto         stack = std::vector<SearchStack>(MAX_PLY + 3);
@@ -337,9 +531,14 @@ MoveEvaluation Searcher::iterativeDeepening(ThreadData& thisThread, Board board,
     for (auto& ss : stack) {
         ss = SearchStack();
     }
+    const PvList& rootPv = thisThread.plyArena.at(0).pv;
 
     const usize searchDepth = std::min(sp.depth, MAX_PLY);
 
+    // At least one line is searched, so positions without legal moves still get a score
+    std::vector<RootMove>& rootMoves = thisThread.rootMoves;
+    const usize            multiPV   = std::clamp<usize>(MULTI_PV, 1, std::max<usize>(rootMoves.size(), 1));
+
     // Pretty printing
     if (isMain && doReporting && !doUci) {
         cursor::home();
@@ -349,52 +548,97 @@ MoveEvaluation Searcher::iterativeDeepening(ThreadData& thisThread, Board board,
     }
 
     for (usize currDepth = 1; currDepth <= searchDepth; currDepth++) {
+        // Depth 1 is always searched so every thread has a score to centre its windows on, and the last depth keeps helpers busy until the main thread ends
+        if (currDepth > 1 && currDepth < searchDepth && skipDepth(thisThread.threadId, currDepth))
+            continue;
+
         SearchLimit& sl = currDepth == 1 ? depthOneSl : mainSl;
 
         const auto searchCancelled = [&]() {
             if (thisThread.type == ThreadType::MAIN)
-                return sl.outOfNodes(totalNodes()) || sl.outOfTime() || thisThread.breakFlag.load(std::memory_order_relaxed);
-            return thisThread.breakFlag.load(std::memory_order_relaxed) || (sp.softNodes > 0 && totalNodes() > sp.softNodes);
+                return sl.outOfNodes(totalNodes()) || sl.outOfTime(totalNodes()) || thisThread.stopRequested();
+            // Deterministic helpers leave soft nodes to the main thread's stop
+            return thisThread.stopRequested() || (thisThread.epochBarrier == nullptr && sp.softNodes > 0 && totalNodes() > sp.softNodes);
         };
 
-        i16 score;
-        if (currDepth < MIN_ASP_WINDOW_DEPTH)
-            score = search<PV>(board, currDepth, 0, -INF_I16, INF_I16, ss, thisThread, transpositionTable, sl);
-        else {
-            int delta = INITIAL_ASP_WINDOW;
-
-            while (!searchCancelled()) {
-                const i16 alpha = std::max<i32>(this->score - delta, -INF_I16);
-                const i16 beta  = std::min<i32>(this->score + delta, INF_I16);
-                score           = search<PV>(board, currDepth, 0, alpha, beta, ss, thisThread, transpositionTable, sl);
-                if (score <= alpha || score >= beta)
-                    delta = ASP_WIDENING_FACTOR / 1024.0 * delta;
-                else
-                    break;
+        for (RootMove& rootMove : rootMoves)
+            rootMove.previousScore = rootMove.score;
+
+        // Each line searches the root moves the earlier lines did not take
+        // A line cancelled before its first search keeps the previous iteration's result
+        i16    score = thisThread.completedScore;
+        PvList pv    = thisThread.completedPv;
+        for (thisThread.pvIdx = 0; thisThread.pvIdx < multiPV; thisThread.pvIdx++) {
+            const usize pvIdx = thisThread.pvIdx;
+
+            i16 lineScore = pvIdx == 0 ? score : rootMoves[pvIdx].previousScore;
+            if (currDepth < MIN_ASP_WINDOW_DEPTH)
+                lineScore = search<PV>(board, currDepth, 0, -INF_I16, INF_I16, ss, thisThread, transpositionTable, sl);
+            else {
+                int       delta  = INITIAL_ASP_WINDOW * (1024 + thisThread.threadId % 4 * SMP_ASP_WINDOW_STEP) / 1024;
+                // Deterministic helpers centre on their own score, the main thread's changes at times they cannot predict
+                const i16 ownScore = thisThread.epochBarrier != nullptr ? thisThread.completedScore : this->score;
+                const i16 center   = pvIdx == 0 ? ownScore : rootMoves[pvIdx].previousScore;
+
+                while (!searchCancelled()) {
+                    const i16 alpha = std::max<i32>(center - delta, -INF_I16);
+                    const i16 beta  = std::min<i32>(center + delta, INF_I16);
+                    lineScore       = search<PV>(board, currDepth, 0, alpha, beta, ss, thisThread, transpositionTable, sl);
+                    if (lineScore <= alpha || lineScore >= beta)
+                        delta = ASP_WIDENING_FACTOR / 1024.0 * delta;
+                    else
+                        break;
+                }
             }
-        }
 
+            if (pvIdx == 0) {
+                score = lineScore;
+                pv    = rootPv;
+            }
 
-        // If depth 1 was searched, save its results
-        if (currDepth == 1) {
+            if (searchCancelled() && currDepth > 1)
+                break;
+
+            // Move the line's best move in front of the moves later lines may still pick
+            const auto best = std::ranges::find(rootMoves.begin() + pvIdx, rootMoves.end(), rootPv.moves[0], &RootMove::move);
+            if (rootPv.length > 0 && best != rootMoves.end()) {
+                best->score = lineScore;
+                best->pv    = rootPv;
+                std::rotate(rootMoves.begin() + pvIdx, best, best + 1);
+
+                // Lines are reported best first, a later line may score above an earlier one
+                std::stable_sort(rootMoves.begin(), rootMoves.begin() + pvIdx + 1, [](const RootMove& a, const RootMove& b) { return a.score > b.score; });
+                score = rootMoves[0].score;
+                pv    = rootMoves[0].pv;
+            }
+        }
+        thisThread.pvIdx = 0;
+
+        const auto saveIteration = [&]() {
             searchLock.lock();
-            this->depth    = 1;
-            this->seldepth = thisThread.seldepth;
-            this->score    = score;
-            this->pv       = ss->pv;
+            thisThread.completedDepth = currDepth;
+            thisThread.completedScore = score;
+            thisThread.completedPv    = pv;
+            // Helpers only publish their own result, the vote at the end decides whether it is played
+            if (isMain) {
+                this->depth    = currDepth;
+                this->seldepth = thisThread.seldepth;
+                this->score    = score;
+                this->pv       = pv;
+                lines.assign(rootMoves.begin(), rootMoves.begin() + std::min(multiPV, rootMoves.size()));
+            }
             searchLock.unlock();
-        }
+        };
+
+        // If depth 1 was searched, save its results
+        if (currDepth == 1)
+            saveIteration();
 
         // If the search has been canceled, exit here to prevent saving partial data
         if (searchCancelled())
             break;
 
-        searchLock.lock();
-        this->depth    = currDepth;
-        this->seldepth = thisThread.seldepth;
-        this->score    = score;
-        this->pv       = ss->pv;
-        searchLock.unlock();
+        saveIteration();
 
 
         if (isMain && doReporting) {
@@ -405,86 +649,79 @@ MoveEvaluation Searcher::iterativeDeepening(ThreadData& thisThread, Board board,
         }
 
         if (isMain) {
-            // Soft nodes
-            if (sp.softNodes > 0 && totalNodes() > sp.softNodes)
-                break;
+            timeManager.update(currDepth, rootMoves.empty() ? Move::null() : rootMoves[0].move, score, rootMoves.empty() ? 0 : rootMoves[0].nodes, thisThread.nodes);
+
             // Go mate
             if (sp.mate > 0 && MATE_SCORE - std::abs(score) / 2 + 1 <= sp.mate)
                 break;
-            // Soft TM
-            if (softTime > 0 && static_cast<i64>(sp.time.elapsed()) >= softTime)
+            // Soft TM and soft nodes
+            if (!pondering.load(std::memory_order_relaxed) && timeManager.stopSoft(mainSl.elapsed(totalNodes()), totalNodes()))
                 break;
         }
     }
 
-    if (isMain && doReporting && doUci) {
-        cout << "info nodes " << totalNodes() << endl;
-        cout << "bestmove " << this->pv.moves[0] << endl;
+    // A finished ponder search holds its move until ponderhit or stop
+    while (isMain && pondering.load(std::memory_order_relaxed) && !thisThread.breakFlag.load(std::memory_order_relaxed))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // Helpers stop before the vote, so the results it compares no longer change
+    if (isMain)
+        thisThread.requestStop();
+
+    // Deterministic helpers only see the stop at their next epoch, the main thread waits for them to leave
+    if (thisThread.epochBarrier != nullptr)
+        thisThread.epochBarrier->arrive_and_drop();
+    runningThreads.fetch_sub(1, std::memory_order_acq_rel);
+    while (isMain && thisThread.epochBarrier != nullptr && runningThreads.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+
+    // The nodes this move did not use stay in the budget, the increment is added on top
+    if (isMain && NODES_TIME > 0 && availableNodes > 0) {
+        const i64 inc   = board.stm == WHITE ? sp.winc : sp.binc;
+        const i64 nodes = totalNodes();
+        availableNodes  = std::max<i64>(availableNodes + inc * static_cast<i64>(NODES_TIME) - nodes, NODES_TIME);
+    }
+
+    if (isMain && threadData.size() > 1 && MULTI_PV == 1) {
+        searchLock.lock();
+        const ThreadData& best = bestThread();
+        const bool        changed = best.threadId != thisThread.threadId && best.completedPv.length > 0 && best.completedPv.moves[0] != this->pv.moves[0];
+        if (changed) {
+            this->depth = best.completedDepth;
+            this->score = best.completedScore;
+            this->pv    = best.completedPv;
+            lines.clear();
+        }
+        searchLock.unlock();
+
+        if (changed && doReporting && doUci)
+            reportUci();
     }
 
-    thisThread.breakFlag.store(true, std::memory_order_relaxed);
+    if (isMain && doReporting && doUci) {
+        cout << "info nodes " << totalNodes() << " tbhits " << totalTbHits() << endl;
+        cout << "bestmove " << this->pv.moves[0];
+        if (this->pv.length > 1)
+            cout << " ponder " << this->pv.moves[1];
+        cout << endl;
+    }
 
     return { this->pv.moves[0], this->score };
 }
 
-void bench() {
+void bench(const usize threads) {
     u64    totalNodes  = 0;
     double totalTimeMs = 0.0;
 
+    u64 evalCacheProbes = 0;
+    u64 evalCacheHits   = 0;
+
+    u64                   tbHits = 0;
+    Tablebase::ProbeStats tbStats;
+
     cout << "Starting benchmark with depth " << BENCH_DEPTH << endl;
 
-    const array<string, 50> fens = { "r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w KQkq a6 0 14",
-                                     "4rrk1/2p1b1p1/p1p3q1/4p3/2P2n1p/1P1NR2P/PB3PP1/3R1QK1 b - - 2 24",
-                                     "r3qbrk/6p1/2b2pPp/p3pP1Q/PpPpP2P/3P1B2/2PB3K/R5R1 w - - 16 42",
-                                     "6k1/1R3p2/6p1/2Bp3p/3P2q1/P7/1P2rQ1K/5R2 b - - 4 44",
-                                     "8/8/1p2k1p1/3p3p/1p1P1P1P/1P2PK2/8/8 w - - 3 54",
-                                     "7r/2p3k1/1p1p1qp1/1P1Bp3/p1P2r1P/P7/4R3/Q4RK1 w - - 0 36",
-                                     "r1bq1rk1/pp2b1pp/n1pp1n2/3P1p2/2P1p3/2N1P2N/PP2BPPP/R1BQ1RK1 b - - 2 10",
-                                     "3r3k/2r4p/1p1b3q/p4P2/P2Pp3/1B2P3/3BQ1RP/6K1 w - - 3 87",
-                                     "2r4r/1p4k1/1Pnp4/3Qb1pq/8/4BpPp/5P2/2RR1BK1 w - - 0 42",
-                                     "4q1bk/6b1/7p/p1p4p/PNPpP2P/KN4P1/3Q4/4R3 b - - 0 37",
-                                     "2q3r1/1r2pk2/pp3pp1/2pP3p/P1Pb1BbP/1P4Q1/R3NPP1/4R1K1 w - - 2 34",
-                                     "1r2r2k/1b4q1/pp5p/2pPp1p1/P3Pn2/1P1B1Q1P/2R3P1/4BR1K b - - 1 37",
-                                     "r3kbbr/pp1n1p1P/3ppnp1/q5N1/1P1pP3/P1N1B3/2P1QP2/R3KB1R b KQkq b3 0 17",
-                                     "8/6pk/2b1Rp2/3r4/1R1B2PP/P5K1/8/2r5 b - - 16 42",
-                                     "1r4k1/4ppb1/2n1b1qp/pB4p1/1n1BP1P1/7P/2PNQPK1/3RN3 w - - 8 29",
-                                     "8/p2B4/PkP5/4p1pK/4Pb1p/5P2/8/8 w - - 29 68",
-                                     "3r4/ppq1ppkp/4bnp1/2pN4/2P1P3/1P4P1/PQ3PBP/R4K2 b - - 2 20",
-                                     "5rr1/4n2k/4q2P/P1P2n2/3B1p2/4pP2/2N1P3/1RR1K2Q w - - 1 49",
-                                     "1r5k/2pq2p1/3p3p/p1pP4/4QP2/PP1R3P/6PK/8 w - - 1 51",
-                                     "q5k1/5ppp/1r3bn1/1B6/P1N2P2/BQ2P1P1/5K1P/8 b - - 2 34",
-                                     "r1b2k1r/5n2/p4q2/1ppn1Pp1/3pp1p1/NP2P3/P1PPBK2/1RQN2R1 w - - 0 22",
-                                     "r1bqk2r/pppp1ppp/5n2/4b3/4P3/P1N5/1PP2PPP/R1BQKB1R w KQkq - 0 5",
-                                     "r1bqr1k1/pp1p1ppp/2p5/8/3N1Q2/P2BB3/1PP2PPP/R3K2n b Q - 1 12",
-                                     "r1bq2k1/p4r1p/1pp2pp1/3p4/1P1B3Q/P2B1N2/2P3PP/4R1K1 b - - 2 19",
-                                     "r4qk1/6r1/1p4p1/2ppBbN1/1p5Q/P7/2P3PP/5RK1 w - - 2 25",
-                                     "r7/6k1/1p6/2pp1p2/7Q/8/p1P2K1P/8 w - - 0 32",
-                                     "r3k2r/ppp1pp1p/2nqb1pn/3p4/4P3/2PP4/PP1NBPPP/R2QK1NR w KQkq - 1 5",
-                                     "3r1rk1/1pp1pn1p/p1n1q1p1/3p4/Q3P3/2P5/PP1NBPPP/4RRK1 w - - 0 12",
-                                     "5rk1/1pp1pn1p/p3Brp1/8/1n6/5N2/PP3PPP/2R2RK1 w - - 2 20",
-                                     "8/1p2pk1p/p1p1r1p1/3n4/8/5R2/PP3PPP/4R1K1 b - - 3 27",
-                                     "8/4pk2/1p1r2p1/p1p4p/Pn5P/3R4/1P3PP1/4RK2 w - - 1 33",
-                                     "8/5k2/1pnrp1p1/p1p4p/P6P/4R1PK/1P3P2/4R3 b - - 1 38",
-                                     "8/8/1p1kp1p1/p1pr1n1p/P6P/1R4P1/1P3PK1/1R6 b - - 15 45",
-                                     "8/8/1p1k2p1/p1prp2p/P2n3P/6P1/1P1R1PK1/4R3 b - - 5 49",
-                                     "8/8/1p4p1/p1p2k1p/P2n1P1P/4K1P1/1P6/3R4 w - - 6 54",
-                                     "8/8/1p4p1/p1p2k1p/P2n1P1P/4K1P1/1P6/6R1 b - - 6 59",
-                                     "8/5k2/1p4p1/p1pK3p/P2n1P1P/6P1/1P6/4R3 b - - 14 63",
-                                     "8/1R6/1p1K1kp1/p6p/P1p2P1P/6P1/1Pn5/8 w - - 0 67",
-                                     "1rb1rn1k/p3q1bp/2p3p1/2p1p3/2P1P2N/PP1RQNP1/1B3P2/4R1K1 b - - 4 23",
-                                     "4rrk1/pp1n1pp1/q5p1/P1pP4/2n3P1/7P/1P3PB1/R1BQ1RK1 w - - 3 22",
-                                     "r2qr1k1/pb1nbppp/1pn1p3/2ppP3/3P4/2PB1NN1/PP3PPP/R1BQR1K1 w - - 4 12",
-                                     "2r2k2/8/4P1R1/1p6/8/P4K1N/7b/2B5 b - - 0 55",
-                                     "6k1/5pp1/8/2bKP2P/2P5/p4PNb/B7/8 b - - 1 44",
-                                     "2rqr1k1/1p3p1p/p2p2p1/P1nPb3/2B1P3/5P2/1PQ2NPP/R1R4K w - - 3 25",
-                                     "r1b2rk1/p1q1ppbp/6p1/2Q5/8/4BP2/PPP3PP/2KR1B1R b - - 2 14",
-                                     "6r1/5k2/p1b1r2p/1pB1p1p1/1Pp3PP/2P1R1K1/2P2P2/3R4 w - - 1 36",
-                                     "rnbqkb1r/pppppppp/5n2/8/2PP4/8/PP2PPPP/RNBQKBNR b KQkq c3 0 2",
-                                     "2rr2k1/1p4bp/p1q1p1p1/4Pp1n/2PB4/1PN3P1/P3Q2P/2RR2K1 w - f6 0 20",
-                                     "3br1k1/p1pn3p/1p3n2/5pNq/2P1p3/1PN3PP/P2Q1PB1/4R1K1 w - - 0 23",
-                                     "2r2b2/5p2/5k2/p1r1pP2/P2pB3/1P3P2/K1P3R1/7R w - - 23 93" };
-
-    for (auto fen : fens) {
+    for (auto fen : BENCH_FENS) {
         if (fen.empty())
             continue;  // Skip empty lines
 
@@ -497,7 +734,8 @@ void bench() {
         Stopwatch<std::chrono::milliseconds> time;
 
         Searcher searcher(false);
-        searcher.start(board, SearchParams(time, BENCH_DEPTH, 0, 0, 0, 0, 0, 0, 0, 0));
+        searcher.setThreads(threads);
+        searcher.start(board, SearchParams(time, BENCH_DEPTH, 0, 0, 0, 0, 0, 0, 0, 0, 0));
         searcher.waitUntilFinished();
 
         const u64 durationMs = time.elapsed();
@@ -505,6 +743,13 @@ void bench() {
         totalNodes += searcher.totalNodes();
         totalTimeMs += durationMs;
 
+        const auto [probes, hits] = searcher.evalCacheStats();
+        evalCacheProbes += probes;
+        evalCacheHits += hits;
+
+        tbHits += searcher.totalTbHits();
+        tbStats += searcher.tablebaseStats();
+
         cout << "FEN: " << fen << endl;
         cout << "Nodes: " << formatNum(searcher.totalNodes()) << ", Time: " << formatTime(durationMs) << endl;
         cout << "----------------------------------------" << endl;
@@ -513,10 +758,74 @@ void bench() {
     cout << "Benchmark Completed." << endl;
     cout << "Total Nodes: " << formatNum(totalNodes) << endl;
     cout << "Total Time: " << formatTime(totalTimeMs) << endl;
+    if (evalCacheProbes > 0)
+        fmt::print("Eval cache: {} KiB per thread, {:.1f}% hits\n", EVAL_CACHE_SIZE, evalCacheHits * 100.0 / evalCacheProbes);
+    if (tbStats.probes > 0) {
+        fmt::print("Tablebases: {} probes, {} tbhits, {:.2f} us per probe\n", tbStats.probes, tbHits, tbStats.nanoseconds / 1000.0 / tbStats.probes);
+
+        // Probes at each depth show where lowering SyzygyProbeDepth starts to cost more than it saves
+        for (usize depth = 0; depth <= MAX_PLY; depth++)
+            if (tbStats.probesAtDepth[depth] > 0)
+                fmt::print("  depth {:>3}: {} probes\n", depth, tbStats.probesAtDepth[depth]);
+    }
     usize nps = 0;
     if (totalTimeMs > 0) {
         nps = totalNodes / totalTimeMs * 1000;
         cout << "Average NPS: " << formatNum(nps) << endl;
     }
     cout << totalNodes << " nodes " << nps << " nps" << endl;
+}
+
+void timeToDepth(const usize maxThreads, const usize depth) {
+    cout << "Measuring time to depth " << depth << " on " << BENCH_FENS.size() << " positions" << endl;
+
+    const bool abdada = ABDADA;
+
+    // Milliseconds each position took with one thread, the baseline of every speedup
+    std::vector<u64> singleThreadMs;
+
+    const auto measure = [&](const string& mode, const usize threads) {
+        u64    totalMs       = 0;
+        u64    totalNodes    = 0;
+        double logSpeedupSum = 0;
+        usize  positions     = 0;
+
+        for (usize i = 0; i < BENCH_FENS.size(); i++) {
+            if (BENCH_FENS[i].empty())
+                continue;
+
+            Board board;
+            board.reset();
+            board.loadFromFEN(BENCH_FENS[i]);
+
+            Stopwatch<std::chrono::milliseconds> time;
+
+            Searcher searcher(false);
+            searcher.setThreads(threads);
+            searcher.start(board, SearchParams(time, depth, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+            searcher.waitUntilFinished();
+
+            const u64 durationMs = std::max<u64>(time.elapsed(), 1);
+            if (threads == 1)
+                singleThreadMs.push_back(durationMs);
+
+            totalMs += durationMs;
+            totalNodes += searcher.totalNodes();
+            logSpeedupSum += std::log(static_cast<double>(singleThreadMs[positions]) / durationMs);
+            positions++;
+        }
+
+        // The geometric mean keeps a few positions that happen to resolve early from dominating
+        fmt::print("{:<8} {:>3} threads: {:>8} ms, {:>12} nodes, speedup {:.2f}x\n", mode, threads, totalMs, totalNodes, std::exp(logSpeedupSum / positions));
+    };
+
+    // Both modes search alike with one thread
+    measure("-", 1);
+    for (const bool mode : { false, true }) {
+        ABDADA = mode;
+        for (usize threads = 2; threads <= maxThreads; threads *= 2)
+            measure(mode ? "ABDADA" : "Lazy SMP", threads);
+    }
+
+    ABDADA = abdada;
 }
\ No newline at end of file
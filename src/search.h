@@ -2,25 +2,86 @@
 
 #include "board.h"
 #include "config.h"
+#include "constants.h"
 #include "stopwatch.h"
 #include "types.h"
 
+#include <atomic>
 #include <cstring>
+#include <memory>
 #include <thread>
 
 struct ThreadData;
 struct ThreadStackManager;
 
+// Fields read by the neighbouring plies, the bulky per-ply state is in the thread's PlyArena
 struct SearchStack {
-    PvList pv{};
-    Move   excluded = Move::null();
-    i16    staticEval{};
+    Move excluded = Move::null();
+    i16  staticEval{};
+    Move killer = Move::null();  // Last quiet that caused a cutoff at this ply
+
+    // Move played from this ply, indexes the continuation histories of the next plies
+    // No piece at the root and after null moves
+    PieceType movedPiece = NO_PIECE_TYPE;
+    Square    movedTo    = a1;
 
     SearchStack()                         = default;
     SearchStack(const SearchStack& other) = default;
     ~SearchStack()                        = default;
 };
 
+// Move lists and PV of one search frame, most nodes only touch their first few entries
+struct PlyData {
+    MoveList        moves;  // Move picker's moves and their scores
+    array<int, 256> moveScores;
+    MoveList        badQuiets;
+    MoveList        badNoisies;
+    MoveList        deferred;  // ABDADA: moves another thread was already searching
+    PvList          pv;
+};
+
+// Per-thread PlyData indexed by ply, so the search's own frames stay small
+// Blocks are allocated the first time the search reaches them, most searches never go deep
+class PlyArena {
+    static constexpr usize BLOCK_SIZE = 8;
+    // Singular verification searches run at their parent's ply, so every ply has a second slot
+    static constexpr usize MAX_SIZE = 2 * (MAX_PLY + 1);
+
+    struct Block {
+        array<PlyData, BLOCK_SIZE> plies;
+    };
+
+    array<std::unique_ptr<Block>, (MAX_SIZE + BLOCK_SIZE - 1) / BLOCK_SIZE> blocks;
+
+   public:
+    PlyArena() = default;
+
+    PlyArena(PlyArena&&) noexcept            = default;
+    PlyArena& operator=(PlyArena&&) noexcept = default;
+    PlyArena(const PlyArena&)                = delete;
+    PlyArena& operator=(const PlyArena&)     = delete;
+
+    PlyData& at(const usize ply, const bool excluded = false) {
+        const usize idx = ply * 2 + excluded;
+        assert(idx < MAX_SIZE);
+        if (!blocks[idx / BLOCK_SIZE]) [[unlikely]]
+            blocks[idx / BLOCK_SIZE] = std::make_unique<Block>();
+        return blocks[idx / BLOCK_SIZE]->plies[idx % BLOCK_SIZE];
+    }
+};
+
+// A move the root may play, with the line its last search found
+struct RootMove {
+    Move   move;
+    i16    score         = -INF_I16;
+    i16    previousScore = -INF_I16;  // Score of the previous iteration, centres the aspiration window of its line
+    PvList pv{};
+    u64    nodes = 0;  // Nodes spent below this move over the whole search
+
+    explicit RootMove(const Move move) :
+        move(move) {}
+};
+
 enum class ThreadType { MAIN = 1, SECONDARY = 0 };
 enum NodeType { NONPV, PV };
 
@@ -35,11 +96,15 @@ struct SearchParams {
     u64   btime;
     u64   winc;
     u64   binc;
+    usize movesToGo;
     usize mate;
 
+    // Only these root moves are searched when not empty
+    MoveList searchMoves{};
+
     SearchParams() = default;
 
-    SearchParams(const Stopwatch<std::chrono::milliseconds>& time, const usize depth, const u64 nodes, const u64 softNodes, const u64 mtime, const u64 wtime, const u64 btime, const u64 winc, const u64 binc, const usize mate) :
+    SearchParams(const Stopwatch<std::chrono::milliseconds>& time, const usize depth, const u64 nodes, const u64 softNodes, const u64 mtime, const u64 wtime, const u64 btime, const u64 winc, const u64 binc, const usize movesToGo, const usize mate) :
         time(time),
         depth(depth),
         nodes(nodes),
@@ -49,6 +114,7 @@ struct SearchParams {
         btime(btime),
         winc(winc),
         binc(binc),
+        movesToGo(movesToGo),
         mate(mate) {}
 };
 
@@ -56,20 +122,30 @@ struct SearchLimit {
     Stopwatch<std::chrono::milliseconds>& time;
     u64                                   maxNodes;
     i64                                   searchTime;
+    // Time limits only apply once the opponent plays the expected move
+    const std::atomic<bool>& pondering;
+    // Under nodestime milliseconds are counted in nodes, so machine load does not change the search
+    u64 nodesPerMs;
 
-    SearchLimit(auto& time, auto searchTime, auto maxNodes) :
+    SearchLimit(auto& time, auto searchTime, auto maxNodes, const std::atomic<bool>& pondering) :
         time(time),
         maxNodes(maxNodes),
-        searchTime(searchTime) {}
+        searchTime(searchTime),
+        pondering(pondering),
+        nodesPerMs(NODES_TIME) {}
 
     bool outOfNodes(const u64 nodes) const {
         return nodes >= maxNodes && maxNodes > 0;
     }
 
-    bool outOfTime() const {
-        if (searchTime == 0)
+    u64 elapsed(const u64 nodes) const {
+        return nodesPerMs > 0 ? nodes / nodesPerMs : time.elapsed();
+    }
+
+    bool outOfTime(const u64 nodes) const {
+        if (searchTime == 0 || pondering.load(std::memory_order_relaxed))
             return false;
-        return static_cast<i64>(time.elapsed()) >= searchTime;
+        return static_cast<i64>(elapsed(nodes)) >= searchTime;
     }
 };
 
@@ -77,14 +153,27 @@ constexpr i16 MATE_SCORE       = 32500;
 constexpr i16 MATE_IN_MAX_PLY  = MATE_SCORE - MAX_PLY;
 constexpr i16 MATED_IN_MAX_PLY = -MATE_SCORE + static_cast<i32>(MAX_PLY);
 
+// Tablebase results sit just below mates, so a real mate is always preferred
+constexpr i16 TB_WIN_SCORE       = MATE_IN_MAX_PLY - 1;
+constexpr i16 TB_WIN_IN_MAX_PLY  = TB_WIN_SCORE - MAX_PLY;
+constexpr i16 TB_LOSS_IN_MAX_PLY = -TB_WIN_IN_MAX_PLY;
+
+// Wins and losses include tablebase results
 inline bool isWin(const i16 score) {
-    return score >= MATE_IN_MAX_PLY;
+    return score >= TB_WIN_IN_MAX_PLY;
 }
 inline bool isLoss(const i16 score) {
-    return score <= MATED_IN_MAX_PLY;
+    return score <= TB_LOSS_IN_MAX_PLY;
 }
 inline bool isDecisive(const i16 score) {
     return isWin(score) || isLoss(score);
 }
+inline bool isMate(const i16 score) {
+    return std::abs(score) >= MATE_IN_MAX_PLY;
+}
+
+extern const array<string, 50> BENCH_FENS;
 
-void bench();
\ No newline at end of file
+void bench(usize threads = 1);
+// Time to reach a fixed depth with 1, 2, 4, ... up to maxThreads threads, relative to one thread, for Lazy SMP and ABDADA
+void timeToDepth(usize maxThreads, usize depth);
\ No newline at end of file
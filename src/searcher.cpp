@@ -1,13 +1,26 @@
 #include "searcher.h"
 #include "cursor.h"
 #include "globals.h"
+#include "movegen.h"
+#include "numa.h"
 #include "search.h"
+#include "tablebase.h"
 #include "types.h"
 #include "wdl.h"
 
-void Searcher::start(const Board& board, const SearchParams sp) {
+void Searcher::start(const Board& board, SearchParams sp, const bool ponder) {
     stop();
 
+    pondering.store(ponder, std::memory_order_relaxed);
+
+    // Under nodestime the remaining time is whatever is left of the node budget, not the GUI's clock
+    u64& time = board.stm == WHITE ? sp.wtime : sp.btime;
+    if (NODES_TIME > 0 && time > 0) {
+        if (availableNodes == 0)
+            availableNodes = time * NODES_TIME;
+        time = availableNodes / NODES_TIME;
+    }
+
     this->sp = sp;
     searchLock.lock();
     this->currentBoard = board;
@@ -15,10 +28,73 @@ void Searcher::start(const Board& board, const SearchParams sp) {
     this->seldepth     = 0;
     this->score        = 0;
     this->pv.length    = 0;
+    this->lines.clear();
     searchLock.unlock();
 
     stopFlag.store(false, std::memory_order_relaxed);
 
+    // Every thread searches with the same networks even if others are loaded mid search
+    const auto network      = nnue.get();
+    const auto smallNetwork = smallNnue.get();
+    Board    root       = board;
+    MoveList legalMoves = Movegen::generateLegalMoves(root);
+
+    // go searchmoves restricts the root, illegal moves in it are ignored
+    if (sp.searchMoves.length > 0) {
+        MoveList allowed;
+        for (const Move m : legalMoves)
+            if (std::ranges::find(sp.searchMoves, m) != sp.searchMoves.end())
+                allowed.add(m);
+        if (allowed.length > 0)
+            legalMoves = allowed;
+    }
+
+    // Roots in the tablebases only search the moves that keep the best result
+    if (Tablebase::canProbe(board))
+        Tablebase::filterRootMoves(board, legalMoves);
+
+    std::vector<RootMove> rootMoves;
+    for (const Move m : legalMoves)
+        rootMoves.emplace_back(m);
+
+    // Deterministic threads only meet at the barrier, one is enough for the whole search
+    epochBarrier.reset();
+    if (DETERMINISTIC_SMP && threadData.size() > 1)
+        epochBarrier = std::make_unique<std::barrier<EpochCompletion>>(threadData.size(), EpochCompletion{ this });
+    runningThreads.store(threadData.size(), std::memory_order_relaxed);
+
+    // ABDADA splits the tree by timing, which deterministic mode cannot allow
+    if (ABDADA && !DETERMINISTIC_SMP && threadData.size() > 1) {
+        if (!busyTable)
+            busyTable = std::make_unique<BusyTable>();
+    }
+    else
+        busyTable.reset();
+
+    for (auto& t : threadData) {
+        t.epochBarrier = epochBarrier.get();
+        t.busyTable    = busyTable.get();
+        t.nextEpoch    = epochBarrier ? DETERMINISTIC_EPOCH_NODES : ~0ULL;
+        t.epoch++;
+        t.ttLog.clear();
+        t.selfStopped  = false;
+        t.epochStopped = false;
+        if (epochBarrier)
+            t.ttOverlay.resize(DETERMINISTIC_OVERLAY_SIZE);
+        else {
+            t.ttOverlay.clear();
+            t.ttOverlay.shrink_to_fit();
+        }
+
+        t.setNetwork(network, smallNetwork);
+        t.rootMoves      = rootMoves;
+        t.completedDepth = 0;
+        t.completedScore = 0;
+        t.completedPv    = PvList{};
+        // Reduce a little more or less than the main thread, in a cycle of three
+        t.lmrOffset = SMP_LMR_PERTURBATION && t.threadId > 0 ? (static_cast<i32>(t.threadId % 3) - 1) * SMP_LMR_OFFSET : 0;
+    }
+
     for (usize i = threadData.size(); i > 0; i--)
         threads.emplace_back(&Searcher::iterativeDeepening, this, std::ref(threadData[i - 1]), board, sp);
 }
@@ -31,6 +107,10 @@ void Searcher::stop() {
     threads.clear();
 }
 
+void Searcher::ponderhit() {
+    pondering.store(false, std::memory_order_relaxed);
+}
+
 void Searcher::waitUntilFinished() {
     for (auto& t : threads)
         if (t.joinable())
@@ -39,10 +119,99 @@ void Searcher::waitUntilFinished() {
 
 void Searcher::setThreads(const usize numThreads) {
     threadData.clear();
-    threadData.emplace_back(ThreadType::MAIN, stopFlag);
+    threadData.reserve(numThreads);
 
-    for (usize i = 1; i < numThreads; i++)
-        threadData.emplace_back(ThreadType::SECONDARY, stopFlag);
+    for (usize i = 0; i < numThreads; i++) {
+        const auto create = [&]() { threadData.emplace_back(i == 0 ? ThreadType::MAIN : ThreadType::SECONDARY, stopFlag, i); };
+
+        // A bound thread touches its data first, so the pages land on its node
+        if (Numa::active(numThreads))
+            std::thread([&]() {
+                Numa::bindThread(i, numThreads);
+                create();
+            }).join();
+        else
+            create();
+    }
+}
+
+void EpochCompletion::operator()() noexcept {
+    searcher->completeEpoch();
+}
+
+void Searcher::completeEpoch() {
+    for (ThreadData& t : threadData) {
+        for (const Transposition& entry : t.ttLog) {
+            Transposition& slot = transpositionTable.getEntry(entry.key);
+            if (transpositionTable.shouldReplace(slot, entry))
+                slot = entry;
+        }
+        t.ttLog.clear();
+    }
+
+    const bool stop = stopFlag.load(std::memory_order_relaxed);
+    for (ThreadData& t : threadData) {
+        t.epoch++;
+        t.epochStopped = stop;
+    }
+}
+
+const ThreadData& Searcher::bestThread() const {
+    const ThreadData* best = &threadData[0];
+
+    i32 minScore = INF_INT;
+    for (const ThreadData& t : threadData)
+        if (t.completedDepth > 0)
+            minScore = std::min<i32>(minScore, t.completedScore);
+
+    // Deeper and better scoring threads weigh more, the worst thread still gets a small say
+    const auto voteWeight = [&](const ThreadData& t) { return static_cast<i64>(t.completedScore - minScore + VOTE_SCORE_OFFSET) * t.completedDepth; };
+
+    std::vector<std::pair<Move, i64>> votes;
+    const auto                        votesFor = [&](const Move m) -> i64& {
+        const auto it = std::ranges::find(votes, m, &std::pair<Move, i64>::first);
+        if (it != votes.end())
+            return it->second;
+        return votes.emplace_back(m, 0).second;
+    };
+
+    for (const ThreadData& t : threadData)
+        if (t.completedDepth > 0 && t.completedPv.length > 0)
+            votesFor(t.completedPv.moves[0]) += voteWeight(t);
+
+    for (const ThreadData& t : threadData) {
+        if (t.completedDepth == 0 || t.completedPv.length == 0)
+            continue;
+        if (best->completedDepth == 0 || best->completedPv.length == 0) {
+            best = &t;
+            continue;
+        }
+
+        const i16 bestScore   = best->completedScore;
+        const i16 threadScore = t.completedScore;
+
+        // Proven wins override the vote, the fastest win is kept
+        // A proven loss never beats a line that is not lost, between losses the slowest is kept
+        if (isWin(bestScore)) {
+            if (threadScore > bestScore)
+                best = &t;
+        }
+        else if (isLoss(bestScore)) {
+            if (!isLoss(threadScore) || threadScore > bestScore)
+                best = &t;
+        }
+        else if (isWin(threadScore))
+            best = &t;
+        else if (!isLoss(threadScore)) {
+            const i64 bestVotes   = votesFor(best->completedPv.moves[0]);
+            const i64 threadVotes = votesFor(t.completedPv.moves[0]);
+            // Between threads backing the same move, the heavier one supplies the PV
+            if (threadVotes > bestVotes || (threadVotes == bestVotes && voteWeight(t) > voteWeight(*best)))
+                best = &t;
+        }
+    }
+
+    return *best;
 }
 
 void Searcher::reportUci() {
@@ -51,23 +220,32 @@ void Searcher::reportUci() {
     const u64 time  = std::max<u64>(sp.time.elapsed(), 1);
     const u64 nodes = totalNodes();
 
-    fmt::print("info depth {} seldepth {} time {} nodes {} nps {} hashfull {}", depth, threadData[0].seldepth, time, nodes, nodes * 1000 / time, transpositionTable.hashfull());
+    // The first line is always reported, later ones only exist with MultiPV
+    for (usize line = 0; line < std::max<usize>(lines.size(), 1); line++) {
+        const i16     lineScore = line == 0 ? score : lines[line].score;
+        const PvList& linePv    = line == 0 ? pv : lines[line].pv;
 
-    fmt::print(" score ");
+        fmt::print("info depth {} seldepth {}", depth, threadData[0].seldepth);
+        if (MULTI_PV > 1)
+            fmt::print(" multipv {}", line + 1);
+        fmt::print(" time {} nodes {} nps {} hashfull {} tbhits {}", time, nodes, nodes * 1000 / time, transpositionTable.hashfull(), totalTbHits());
 
-    if (isDecisive(score))
-        fmt::print("mate {}", std::copysign((MATE_SCORE - std::abs(score)) / 2 + 1, score));
-    else
-        fmt::print("cp {}", scaleEval(score, currentBoard));
+        fmt::print(" score ");
 
-    const auto [w, d, l] = getWDL(currentBoard, score);
-    fmt::print(" wdl {} {} {}", w, d, l);
+        if (isMate(lineScore))
+            fmt::print("mate {}", std::copysign((MATE_SCORE - std::abs(lineScore)) / 2 + 1, lineScore));
+        else
+            fmt::print("cp {}", scaleEval(lineScore, currentBoard));
 
-    fmt::print(" pv");
-    for (const Move m : pv)
-        cout << " " << m;
+        const auto [w, d, l] = getWDL(currentBoard, lineScore);
+        fmt::print(" wdl {} {} {}", w, d, l);
 
-    cout << endl;
+        fmt::print(" pv");
+        for (const Move m : linePv)
+            cout << " " << m;
+
+        cout << endl;
+    }
     searchLock.unlock();
 }
 
@@ -5,6 +5,7 @@
 #include "ttable.h"
 
 #include <barrier>
+#include <memory>
 #include <mutex>
 #include <thread>
 
@@ -12,6 +13,8 @@ struct Searcher {
     TranspositionTable transpositionTable;
 
     std::atomic<bool>        stopFlag{ true };
+    // Set while searching the expected reply, until ponderhit or stop
+    std::atomic<bool> pondering{ false };
     std::vector<ThreadData>  threadData;
     std::vector<std::thread> threads;
 
@@ -24,6 +27,18 @@ struct Searcher {
     usize      seldepth{};
     i16        score{};
     PvList     pv{};
+    // Every MultiPV line of the last completed iteration, the first one matches score and pv
+    std::vector<RootMove> lines{};
+
+    // Node budget of the game under nodestime, taken from the clock of the first timed search
+    i64 availableNodes = 0;
+
+    // Threads still inside iterativeDeepening
+    std::atomic<usize> runningThreads{ 0 };
+    // Only set in deterministic mode with more than one thread
+    std::unique_ptr<std::barrier<EpochCompletion>> epochBarrier;
+    // Only set in ABDADA mode with more than one thread
+    std::unique_ptr<BusyTable> busyTable;
 
     bool doReporting;
 
@@ -45,8 +60,25 @@ struct Searcher {
         return nodes;
     }
 
-    void start(const Board& board, SearchParams sp);
+    u64 totalTbHits() const {
+        u64 tbHits = 0;
+        for (const ThreadData& t : threadData)
+            tbHits += t.tbHits.load(std::memory_order_relaxed);
+        return tbHits;
+    }
+
+    // Tablebase probe counters of every thread
+    Tablebase::ProbeStats tablebaseStats() const {
+        Tablebase::ProbeStats stats;
+        for (const ThreadData& t : threadData)
+            stats += t.tbStats;
+        return stats;
+    }
+
+    void start(const Board& board, SearchParams sp, bool ponder = false);
     void stop();
+    // The opponent played the expected move, the running search keeps going with its time limits counted from the ponder start
+    void ponderhit();
     void waitUntilFinished();
 
     void setThreads(usize numThreads);
@@ -56,12 +88,36 @@ struct Searcher {
         transpositionTable.clear();
     }
 
+    void resizeEvalCache(const usize newSizeKiB) {
+        EVAL_CACHE_SIZE = newSizeKiB;
+        for (auto& t : threadData)
+            t.evalCache.resize(newSizeKiB);
+    }
+
+    // Probes and hits of every thread's eval cache
+    std::pair<u64, u64> evalCacheStats() const {
+        u64 probes = 0;
+        u64 hits   = 0;
+        for (const ThreadData& t : threadData) {
+            probes += t.evalCache.probes;
+            hits += t.evalCache.hits;
+        }
+        return { probes, hits };
+    }
+
     void reset() {
+        availableNodes = 0;
         transpositionTable.clear();
         for (auto& t : threadData)
             t.reset();
     }
 
+    // Apply the epoch's TT writes in thread order and share stops, runs while every thread waits
+    void completeEpoch();
+
+    // Thread whose move wins a vote weighted by completed depth and score, call with searchLock held
+    const ThreadData& bestThread() const;
+
     MoveEvaluation iterativeDeepening(ThreadData& thisThread, Board board, SearchParams sp);
 
     void reportUci();
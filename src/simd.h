@@ -4,6 +4,12 @@
 
 #include <cstring>
 
+#if defined(__x86_64__)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
 // Based on Vine
 namespace simd {
 #if __x86_64__
@@ -60,6 +66,11 @@ inline Vector<T> add_ep(const Vector<T> a, const Vector<T> b) {
     return a + b;
 }
 
+template<typename T>
+inline Vector<T> sub_ep(const Vector<T> a, const Vector<T> b) {
+    return a - b;
+}
+
 template<typename T>
 inline T reduce_ep(const Vector<T> v) {
     T vals[VECTOR_SIZE<T>];
@@ -88,8 +99,41 @@ inline Vector<T> mullo_ep(const Vector<T> a, const Vector<T> b) {
     return a * b;
 }
 
+template<typename T>
+inline Vector<T> set1_ep(const T v) {
+    return Vector<T>{} + v;
+}
+
+// Bitmask of the lanes that are not zero
+inline u32 nonzeroMaskGeneric_epi32(const Vector<i32> v) {
+    i32 vals[VECTOR_SIZE<i32>];
+    std::memcpy(vals, &v, sizeof(vals));
+
+    u32 mask = 0;
+    for (usize i = 0; i < VECTOR_SIZE<i32>; i++)
+        mask |= static_cast<u32>(vals[i] != 0) << i;
+    return mask;
+}
+
+// Multiplies the u8 lanes of a with the i8 lanes of b and adds each group of 4 products to acc
+inline Vector<i32> dpbusdGeneric_epi32(const Vector<i32> acc, const Vector<i32> a, const Vector<i32> b) {
+    u8  aVals[VECTOR_BYTES];
+    i8  bVals[VECTOR_BYTES];
+    i32 vals[VECTOR_SIZE<i32>];
+    std::memcpy(aVals, &a, sizeof(aVals));
+    std::memcpy(bVals, &b, sizeof(bVals));
+    std::memcpy(vals, &acc, sizeof(vals));
+
+    for (usize i = 0; i < VECTOR_SIZE<i32>; i++)
+        for (usize j = 0; j < 4; j++)
+            vals[i] += static_cast<i32>(aVals[i * 4 + j]) * bVals[i * 4 + j];
+
+    Vector<i32> result;
+    std::memcpy(&result, vals, sizeof(vals));
+    return result;
+}
+
 #ifdef __x86_64__
-    #include <immintrin.h>
 inline Vector<i32> madd_epi16(const Vector<i16> a, const Vector<i16> b) {
     #if defined(__AVX512F__)
     return _mm512_madd_epi16(a, b);
@@ -99,10 +143,34 @@ inline Vector<i32> madd_epi16(const Vector<i16> a, const Vector<i16> b) {
     return _mm_madd_epi16(a, b);
     #endif
 }
+
+inline u32 nonzeroMask_epi32(const Vector<i32> v) {
+    #if defined(__AVX512F__)
+    return _mm512_test_epi32_mask(v, v);
+    #elif defined(__AVX2__)
+    return _mm256_movemask_ps(_mm256_castsi256_ps(v != 0));
+    #elif defined(__SSE2__)
+    return _mm_movemask_ps(_mm_castsi128_ps(v != 0));
+    #else
+    return nonzeroMaskGeneric_epi32(v);
+    #endif
+}
+
+inline Vector<i32> dpbusd_epi32(const Vector<i32> acc, const Vector<i32> a, const Vector<i32> b) {
+    #if defined(__AVX512VNNI__)
+    return _mm512_dpbusd_epi32(acc, a, b);
+    #elif defined(__AVX512F__)
+    return _mm512_add_epi32(acc, _mm512_madd_epi16(_mm512_maddubs_epi16(a, b), _mm512_set1_epi16(1)));
+    #elif defined(__AVX2__)
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(a, b), _mm256_set1_epi16(1)));
+    #elif defined(__SSSE3__)
+    return _mm_add_epi32(acc, _mm_madd_epi16(_mm_maddubs_epi16(a, b), _mm_set1_epi16(1)));
+    #else
+    return dpbusdGeneric_epi32(acc, a, b);
+    #endif
+}
 #elif defined(__arm__) || defined(__aarch64__)
     #if defined(__ARM_NEON)
-        #include <arm_neon.h>
-
 inline Vector<i32> madd_epi16(const Vector<i16> a, const Vector<i16> b) {
     int32x4_t mul_low  = vmull_s16(vget_low_s16(a), vget_low_s16(b));
     int32x4_t mul_high = vmull_s16(vget_high_s16(a), vget_high_s16(b));
@@ -110,6 +178,14 @@ inline Vector<i32> madd_epi16(const Vector<i16> a, const Vector<i16> b) {
     return vaddq_s32(mul_low, mul_high);
 }
 
+inline u32 nonzeroMask_epi32(const Vector<i32> v) {
+    return nonzeroMaskGeneric_epi32(v);
+}
+
+inline Vector<i32> dpbusd_epi32(const Vector<i32> acc, const Vector<i32> a, const Vector<i32> b) {
+    return dpbusdGeneric_epi32(acc, a, b);
+}
+
     #endif
 #endif
 }
\ No newline at end of file
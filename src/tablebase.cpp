@@ -0,0 +1,196 @@
+#include "tablebase.h"
+#include "config.h"
+
+#include "../external/Pyrrhic/tbprobe.h"
+
+#include <algorithm>
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+#ifdef _WIN32
+constexpr char PATH_SEPARATOR = ';';
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+
+constexpr char PATH_SEPARATOR = ':';
+#endif
+
+namespace Tablebase {
+// Directories of the loaded tables, for warmup
+static std::vector<string> directories;
+
+usize init(const string& path) {
+    directories.clear();
+    if (!tb_init(path.c_str())) {
+        cerr << "Failed to load tablebases from " << path << endl;
+        tb_init("<empty>");
+        return 0;
+    }
+
+    if (largest() > 0)
+        directories = split(path, PATH_SEPARATOR);
+    return largest();
+}
+
+usize largest() {
+    return TB_LARGEST;
+}
+
+bool canProbe(const Board& board) {
+    const usize pieces = popcount(board.pieces());
+    return pieces <= largest() && pieces <= SYZYGY_PROBE_LIMIT;
+}
+
+bool canProbeWDL(const Board& board) {
+    return board.halfMoveClock == 0 && std::ranges::none_of(board.castling, [](const Square sq) { return sq != NO_SQUARE; }) && canProbe(board);
+}
+
+WDL probeWDL(const Board& board) {
+    assert(canProbeWDL(board));
+
+    const unsigned result = tb_probe_wdl(board.pieces(WHITE),
+                                         board.pieces(BLACK),
+                                         board.pieces(KING),
+                                         board.pieces(QUEEN),
+                                         board.pieces(ROOK),
+                                         board.pieces(BISHOP),
+                                         board.pieces(KNIGHT),
+                                         board.pieces(PAWN),
+                                         board.epSquare == NO_SQUARE ? 0 : board.epSquare,
+                                         board.stm == WHITE);
+
+    if (result == TB_RESULT_FAILED)
+        return WDL::FAILED;
+    if (result == TB_WIN)
+        return WDL::WIN;
+    if (result == TB_LOSS)
+        return WDL::LOSS;
+    return WDL::DRAW;
+}
+
+// Read every page of a file once, Pyrrhic maps the same file later and finds the pages cached
+static u64 touchFile(const string& filepath) {
+#ifdef _WIN32
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file)
+        return 0;
+
+    const auto buffer = std::make_unique<char[]>(1 << 20);
+    u64        bytes  = 0;
+    while (file.read(buffer.get(), 1 << 20) || file.gcount() > 0)
+        bytes += file.gcount();
+    return bytes;
+#else
+    const int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    const usize size = fileStat.st_size;
+
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+
+    // Ask for the whole file up front so the reads below overlap with the disk
+    madvise(data, size, MADV_WILLNEED);
+
+    const auto* bytes    = static_cast<const volatile u8*>(data);
+    const usize pageSize = sysconf(_SC_PAGESIZE);
+    u8          sum      = 0;
+    for (usize offset = 0; offset < size; offset += pageSize)
+        sum += bytes[offset];
+    (void) sum;
+
+    munmap(data, size);
+    return size;
+#endif
+}
+
+u64 warmup() {
+    u64 bytes = 0;
+    for (const string& directory : directories) {
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+            if (entry.is_regular_file() && entry.path().extension() == ".rtbw")
+                bytes += touchFile(entry.path().string());
+    }
+    return bytes;
+}
+
+bool filterRootMoves(const Board& board, MoveList& rootMoves) {
+    if (std::ranges::any_of(board.castling, [](const Square sq) { return sq != NO_SQUARE; }))
+        return false;
+
+    // Repetitions since the last zeroing move change which DTZ results are safe
+    bool hasRepeated = false;
+    for (usize i = 0; i < board.posHistory.size() && !hasRepeated; i++)
+        hasRepeated = std::find(board.posHistory.begin() + i + 1, board.posHistory.end(), board.posHistory[i]) != board.posHistory.end();
+
+    const auto results = std::make_unique<TbRootMoves>();
+
+    const auto probe = [&](const bool dtz) {
+        const u64  white   = board.pieces(WHITE);
+        const u64  black   = board.pieces(BLACK);
+        const u64  kings   = board.pieces(KING);
+        const u64  queens  = board.pieces(QUEEN);
+        const u64  rooks   = board.pieces(ROOK);
+        const u64  bishops = board.pieces(BISHOP);
+        const u64  knights = board.pieces(KNIGHT);
+        const u64  pawns   = board.pieces(PAWN);
+        const auto rule50  = static_cast<unsigned>(board.halfMoveClock);
+        const auto ep      = static_cast<unsigned>(board.epSquare == NO_SQUARE ? 0 : board.epSquare);
+        const bool turn    = board.stm == WHITE;
+
+        if (dtz)
+            return tb_probe_root_dtz(white, black, kings, queens, rooks, bishops, knights, pawns, rule50, ep, turn, hasRepeated, results.get());
+        return tb_probe_root_wdl(white, black, kings, queens, rooks, bishops, knights, pawns, rule50, ep, turn, true, results.get());
+    };
+
+    // DTZ tables may be missing for some material, WDL still avoids throwing the result away
+    if ((!probe(true) && !probe(false)) || results->size == 0)
+        return false;
+
+    i32 bestRank = results->moves[0].tbRank;
+    for (usize i = 1; i < results->size; i++)
+        bestRank = std::max(bestRank, results->moves[i].tbRank);
+
+    MoveList filtered;
+    for (usize i = 0; i < results->size; i++) {
+        const TbRootMove& tbMove = results->moves[i];
+        if (tbMove.tbRank != bestRank)
+            continue;
+
+        const u8 from  = PYRRHIC_MOVE_FROM(tbMove.move);
+        const u8 to    = PYRRHIC_MOVE_TO(tbMove.move);
+        const u8 promo = PYRRHIC_MOVE_FLAGS(tbMove.move) & PYRRHIC_MASK_PROMO_FLAGS;
+
+        for (const Move m : rootMoves) {
+            if (m.from() != from || m.to() != to)
+                continue;
+
+            // Pyrrhic numbers promotions queen, rook, bishop, knight from 1
+            if (m.typeOf() == PROMOTION && promo != PYRRHIC_FLAG_NONE && m.promo() != static_cast<PieceType>(QUEEN - promo + 1))
+                continue;
+
+            filtered.add(m);
+        }
+    }
+
+    if (filtered.length == 0)
+        return false;
+
+    rootMoves = filtered;
+    return true;
+}
+}
\ No newline at end of file
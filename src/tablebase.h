@@ -0,0 +1,50 @@
+#pragma once
+
+#include "board.h"
+#include "config.h"
+#include "move.h"
+#include "types.h"
+
+namespace Tablebase {
+// Counters of one thread's probes inside the search, to weigh probe depth against I/O cost
+struct ProbeStats {
+    u64 probes      = 0;  // Probes that reached the tables, failed ones included
+    u64 nanoseconds = 0;  // Time spent inside the prober
+
+    // Probes at each remaining depth, capped by SYZYGY_PROBES_PER_DEPTH
+    array<u32, MAX_PLY + 1> probesAtDepth{};
+
+    void operator+=(const ProbeStats& other) {
+        probes += other.probes;
+        nanoseconds += other.nanoseconds;
+        for (usize depth = 0; depth <= MAX_PLY; depth++)
+            probesAtDepth[depth] += other.probesAtDepth[depth];
+    }
+};
+
+// Result for the side to move, cursed wins and blessed losses are draws under the 50 move rule
+enum class WDL { LOSS, DRAW, WIN, FAILED };
+
+// Load the tables found in path, an empty path or "<empty>" unloads them
+// Returns the largest number of pieces the loaded tables cover
+usize init(const string& path);
+
+// Largest number of pieces of the loaded tables, 0 when none are loaded
+usize largest();
+
+// Whether the position may be in the tables and not past the probe limit
+bool canProbe(const Board& board);
+// Pyrrhic only knows WDL results for positions that cannot castle and have a clean 50 move counter
+bool canProbeWDL(const Board& board);
+
+// Only valid when canProbeWDL holds
+WDL probeWDL(const Board& board);
+
+// Bring the WDL files into the page cache, so the first probes of a search do not wait on the disk
+// Returns the number of bytes read
+u64 warmup();
+
+// Keep only the root moves that preserve the best result, using DTZ when it is available
+// Returns false and leaves the moves untouched if the root is not in the tables
+bool filterRootMoves(const Board& board, MoveList& rootMoves);
+}
\ No newline at end of file
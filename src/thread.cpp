@@ -1,30 +1,80 @@
 #include "thread.h"
+#include "globals.h"
+
 #include <tuple>
 
-ThreadData::ThreadData(const ThreadType type, std::atomic<bool>& breakFlag) :
+ThreadData::ThreadData(const ThreadType type, std::atomic<bool>& breakFlag, const usize threadId) :
+    contHist(std::make_unique<decltype(contHist)::element_type>()),
+    evalCache(EVAL_CACHE_SIZE),
     type(type),
+    threadId(threadId),
     breakFlag(breakFlag) {
     breakFlag.store(false, std::memory_order_relaxed);
 
     deepFill(history, 0);
     nodes    = 0;
+    tbHits   = 0;
     seldepth = 0;
 }
-ThreadData::ThreadData(const ThreadData& other) :
+ThreadData::ThreadData(ThreadData&& other) noexcept :
     history(other.history),
-    accumulatorStack(other.accumulatorStack),
+    capthist(other.capthist),
+    contHist(std::move(other.contHist)),
+    pawnCorrhist(other.pawnCorrhist),
+    majorCorrhist(other.majorCorrhist),
+    accumulatorStack(std::move(other.accumulatorStack)),
+    smallAccumulatorStack(std::move(other.smallAccumulatorStack)),
+    plyArena(std::move(other.plyArena)),
+    evalCache(std::move(other.evalCache)),
+    network(std::move(other.network)),
+    smallNetwork(std::move(other.smallNetwork)),
+    nnue(other.nnue),
+    smallNnue(other.smallNnue),
     type(other.type),
+    threadId(other.threadId),
     breakFlag(other.breakFlag),
-    seldepth(other.seldepth) {
+    seldepth(other.seldepth),
+    tbStats(other.tbStats),
+    rootMoves(std::move(other.rootMoves)),
+    pvIdx(other.pvIdx),
+    completedDepth(other.completedDepth),
+    completedScore(other.completedScore),
+    completedPv(other.completedPv),
+    lmrOffset(other.lmrOffset),
+    busyTable(other.busyTable),
+    ttOverlay(std::move(other.ttOverlay)),
+    ttLog(std::move(other.ttLog)),
+    epochBarrier(other.epochBarrier),
+    epoch(other.epoch),
+    nextEpoch(other.nextEpoch),
+    selfStopped(other.selfStopped),
+    epochStopped(other.epochStopped) {
     nodes.store(other.nodes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    tbHits.store(other.tbHits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void ThreadData::prefetch(const Board& board, const Move m) const {
+    const auto [pawnKey, majorKey] = board.correctionKeysAfter(m);
+    __builtin_prefetch(&pawnCorrhist[~board.stm][pawnKey % CORRHIST_SIZE]);
+    __builtin_prefetch(&majorCorrhist[~board.stm][majorKey % CORRHIST_SIZE]);
+
+    prefetchNetwork(board, m);
+}
+
+void ThreadData::prefetchNetwork(const Board& board, const Move m) const {
+    const AccumulatorUpdate update = AccumulatorUpdate::fromMove(board, m);
+    nnue->prefetch(update);
+    if (smallNnue)
+        smallNnue->prefetch(update);
 }
 
 std::pair<Board, ThreadStackManager> ThreadData::makeMove(const Board& board, const Move m) {
     Board newBoard = board;
     newBoard.move(m);
 
-    accumulatorStack.push(accumulatorStack.top());
-    accumulatorStack.topAsReference().update(newBoard, m, board.getPiece(m.to()));
+    assert(board.correctionKeysAfter(m) == std::make_pair(newBoard.pawnHash, newBoard.majorHash));
+
+    pushAccumulators(AccumulatorUpdate::fromMove(board, m));
 
     return { std::piecewise_construct, std::forward_as_tuple(std::move(newBoard)), std::forward_as_tuple(*this) };
 }
@@ -33,22 +83,90 @@ std::pair<Board, ThreadStackManager> ThreadData::makeNullMove(const Board& board
     Board newBoard = board;
     newBoard.nullMove();
 
-    accumulatorStack.push(accumulatorStack.top());
+    // An empty update, so the parent is copied only if the child is written
+    pushAccumulators(AccumulatorUpdate());
 
     return { std::piecewise_construct, std::forward_as_tuple(std::move(newBoard)), std::forward_as_tuple(*this) };
 }
 
+void ThreadData::setNetwork(std::shared_ptr<const Network> network, std::shared_ptr<const Network> smallNetwork) {
+    // Cached outputs belong to the previous networks
+    if (network != this->network || smallNetwork != this->smallNetwork)
+        evalCache.clear();
+
+    this->network      = std::move(network);
+    this->smallNetwork = std::move(smallNetwork);
+    nnue               = &**this->network;
+    smallNnue          = this->smallNetwork ? &**this->smallNetwork : nullptr;
+
+    // Each stack holds values for the hidden layer of the network it serves
+    accumulatorStack.setHlSize(nnue->hlSize());
+    if (smallNnue)
+        smallAccumulatorStack.setHlSize(smallNnue->hlSize());
+}
+
+void ThreadData::pushAccumulators(const AccumulatorUpdate& update) {
+    // Parents are left pending too, each network writes its own stack only when it evaluates
+    const auto push = [&](AccumulatorStack& stack) {
+        AccumulatorPair& child = stack.push();
+        child.dirty            = true;
+        child.pending          = update;
+    };
+
+    push(accumulatorStack);
+    if (smallNnue)
+        push(smallAccumulatorStack);
+}
+
+void ThreadData::popAccumulators() {
+    accumulatorStack.pop();
+    if (smallNnue)
+        smallAccumulatorStack.pop();
+}
+
+bool ThreadData::useSmallNetwork(const Board& b) const {
+    if (!smallNnue)
+        return false;
+
+    i32 material = 0;
+    for (PieceType pt = PAWN; pt <= QUEEN; pt = static_cast<PieceType>(pt + 1))
+        material += (popcount(b.pieces(WHITE, pt)) - popcount(b.pieces(BLACK, pt))) * getPieceValue(pt);
+
+    return std::abs(material) > SMALL_NET_THRESHOLD;
+}
+
+i16 ThreadData::evaluate(const Board& b) {
+    i32 eval;
+    if (!evalCache.probe(b.fullHash, eval)) {
+        eval = useSmallNetwork(b) ? smallNnue->evaluate(b, smallAccumulatorStack) : nnue->evaluate(b, accumulatorStack);
+        evalCache.store(b.fullHash, eval);
+    }
+    return std::clamp<i32>(eval, TB_LOSS_IN_MAX_PLY + 1, TB_WIN_IN_MAX_PLY - 1);
+}
+
+i16 ThreadData::evaluateLeaf(const Board& b) {
+    i32 eval;
+    if (!evalCache.probe(b.fullHash, eval)) {
+        eval = useSmallNetwork(b) ? smallNnue->evaluateLeaf(b, smallAccumulatorStack) : nnue->evaluateLeaf(b, accumulatorStack);
+        evalCache.store(b.fullHash, eval);
+    }
+    return std::clamp<i32>(eval, TB_LOSS_IN_MAX_PLY + 1, TB_WIN_IN_MAX_PLY - 1);
+}
+
 void ThreadData::refresh(const Board& b) {
     accumulatorStack.clear();
+    nnue->refresh(b, accumulatorStack.push());
 
-    AccumulatorPair accumulators{};
-    accumulators.resetAccumulators(b);
-    accumulatorStack.push(accumulators);
+    smallAccumulatorStack.clear();
+    if (smallNnue)
+        smallNnue->refresh(b, smallAccumulatorStack.push());
 }
 
 void ThreadData::reset() {
     deepFill(history, 0);
     deepFill(capthist, 0);
+    deepFill(*contHist, 0);
     deepFill(pawnCorrhist, 0);
     deepFill(majorCorrhist, 0);
+    evalCache.clear();
 }
\ No newline at end of file
@@ -1,19 +1,40 @@
 #pragma once
 
 #include "accumulator.h"
+#include "busytable.h"
+#include "evalcache.h"
 #include "search.h"
+#include "tablebase.h"
+#include "ttable.h"
 #include "types.h"
 
+#include <barrier>
+#include <limits>
+#include <memory>
 #include <utility>
 
-template<i32 MAX_VALUE>
+struct NNUE;
+class Network;
+struct Searcher;
+
+// Runs on the last thread to reach the end of an epoch, while the others wait
+struct EpochCompletion {
+    Searcher* searcher;
+
+    void operator()() noexcept;
+};
+
+// Stored in the smallest type that holds the range, the update is done in i32 and saturates on the way back
+template<typename T, i32 MAX_VALUE>
 struct HistoryEntry {
-    i32 value;
+    static_assert(MAX_VALUE <= std::numeric_limits<T>::max() && -MAX_VALUE >= std::numeric_limits<T>::min());
+
+    T value;
 
     HistoryEntry() :
         value(0) {}
     HistoryEntry(const i32 v) :
-        value(v) {}
+        value(static_cast<T>(std::clamp<i32>(v, -MAX_VALUE, MAX_VALUE))) {}
 
     operator i32() const {
         return value;
@@ -21,38 +42,95 @@ struct HistoryEntry {
 
     void update(const i32 bonus) {
         const i32 clampedBonus = std::clamp<i32>(bonus, -MAX_VALUE, MAX_VALUE);
-        value += clampedBonus - value * abs(clampedBonus) / MAX_VALUE;
+        const i32 current      = value;
+        value                  = static_cast<T>(std::clamp<i32>(current + clampedBonus - current * abs(clampedBonus) / MAX_VALUE, -MAX_VALUE, MAX_VALUE));
     }
 };
 
 struct ThreadData {
     // History is indexed [stm][from][to]
-    MultiArray<HistoryEntry<MAX_HISTORY>, 2, 64, 64> history;
+    MultiArray<HistoryEntry<i16, MAX_HISTORY>, 2, 64, 64> history;
 
     // Capthist is indexed [stm][pt][captured pt][to]
     // En passant is a possible capture with no targeted type
-    MultiArray<HistoryEntry<MAX_HISTORY>, 2, 6, 7, 64> capthist;
+    MultiArray<HistoryEntry<i16, MAX_HISTORY>, 2, 6, 7, 64> capthist;
+
+    // Continuation histories are indexed [plies back - 1][stm][previous pt][previous to][pt][to]
+    // The previous move is the one played 1 or 2 plies earlier
+    // Piece types carry no colour, stm tells a white move and its reply apart from the mirrored black ones
+    // Over a megabyte, so it lives on the heap and a moved thread keeps the same table
+    std::unique_ptr<MultiArray<HistoryEntry<i16, MAX_HISTORY>, 2, 2, 6, 64, 6, 64>> contHist;
 
     // Pawn correction history indexed [stm][pawn key % size]
-    MultiArray<HistoryEntry<MAX_CORRHIST>, 2, CORRHIST_SIZE> pawnCorrhist;
+    MultiArray<HistoryEntry<i16, MAX_CORRHIST>, 2, CORRHIST_SIZE> pawnCorrhist;
 
     // Major correction history indexed [stm][major key % size]
-    MultiArray<HistoryEntry<MAX_CORRHIST>, 2, CORRHIST_SIZE> majorCorrhist;
+    MultiArray<HistoryEntry<i16, MAX_CORRHIST>, 2, CORRHIST_SIZE> majorCorrhist;
 
     // All the accumulators for each thread's search
-    Stack<AccumulatorPair, MAX_PLY + 1> accumulatorStack;
+    AccumulatorStack accumulatorStack;
+    // Accumulators of the small network, only kept when one is loaded
+    AccumulatorStack smallAccumulatorStack;
+
+    // Move lists and PVs of the search's frames
+    PlyArena plyArena;
+
+    // Raw network outputs of positions this thread has evaluated
+    EvalCache evalCache;
+
+    // Networks pinned for the current search, the accumulators are only valid for these networks
+    std::shared_ptr<const Network> network;
+    std::shared_ptr<const Network> smallNetwork;
+    const NNUE*                    nnue      = nullptr;
+    const NNUE*                    smallNnue = nullptr;
 
     ThreadType type;
+    // Index in the searcher, 0 is the main thread
+    usize threadId;
 
     std::atomic<bool>& breakFlag;
 
     std::atomic<u64> nodes;
+    std::atomic<u64> tbHits;
     usize            seldepth;
 
-    ThreadData(ThreadType type, std::atomic<bool>& breakFlag);
+    Tablebase::ProbeStats tbStats;
+
+    // Moves the root may play, set by the searcher before each search
+    // The first MultiPV moves are the lines of the current iteration, in order
+    std::vector<RootMove> rootMoves;
+    // Line being searched, root moves before it belong to earlier lines
+    usize pvIdx = 0;
+
+    // Last iteration this thread completed, written under the searcher's lock for the best thread vote
+    usize  completedDepth = 0;
+    i16    completedScore = 0;
+    PvList completedPv{};
+
+    // Added to every LMR reduction, helpers may be given their own so their trees differ from the main thread's
+    i32 lmrOffset = 0;
+
+    // Shared table of positions being searched, only set in ABDADA mode
+    BusyTable* busyTable = nullptr;
+
+    // Deterministic SMP, unused unless the searcher sets an epoch barrier
+    // Entries read or written this epoch, other threads' writes only show up after the barrier
+    struct OverlayEntry {
+        Transposition entry;
+        u64           epoch = ~0ULL;
+    };
+    std::vector<OverlayEntry>      ttOverlay;
+    std::vector<Transposition>     ttLog;  // Writes of this epoch, applied by the barrier in thread order
+    std::barrier<EpochCompletion>* epochBarrier = nullptr;
+    u64                            epoch        = 0;
+    u64                            nextEpoch    = ~0ULL;  // Node count at which the thread waits for the others
+    bool                           selfStopped  = false;  // This thread decided to stop
+    bool                           epochStopped = false;  // Stop seen by the last barrier
+
+    ThreadData(ThreadType type, std::atomic<bool>& breakFlag, usize threadId = 0);
 
-    // Copy constructor
-    ThreadData(const ThreadData& other);
+    // Only moved when the searcher's vector grows, the accumulator stacks are not copyable
+    ThreadData(ThreadData&& other) noexcept;
 
     // Accessors for the histories
     auto& getHistory(const Board& b, const Move m) {
@@ -67,6 +145,26 @@ struct ThreadData {
     auto& getCaptureHistory(const Board& b, const Move m) const {
         return capthist[b.stm][b.getPiece(m.from())][b.getPiece(m.to())][m.to()];
     }
+    // Butterfly history of a quiet plus its continuation histories
+    i32 getQuietHistory(const Board& b, const SearchStack* ss, const Move m) const {
+        i32             score = getHistory(b, m);
+        const PieceType pt    = b.getPiece(m.from());
+        for (usize i = 0; i < 2; i++) {
+            const SearchStack* prev = ss - i - 1;
+            if (prev->movedPiece != NO_PIECE_TYPE)
+                score += (*contHist)[i][b.stm][prev->movedPiece][prev->movedTo][pt][m.to()];
+        }
+        return score;
+    }
+    void updateQuietHistory(const Board& b, const SearchStack* ss, const Move m, const i32 bonus) {
+        getHistory(b, m).update(bonus);
+        const PieceType pt = b.getPiece(m.from());
+        for (usize i = 0; i < 2; i++) {
+            const SearchStack* prev = ss - i - 1;
+            if (prev->movedPiece != NO_PIECE_TYPE)
+                (*contHist)[i][b.stm][prev->movedPiece][prev->movedTo][pt][m.to()].update(bonus);
+        }
+    }
     void updateCorrhist(const Board& b, const i16 depth, const i16 score, const i16 eval) {
         const i32 bonus = std::clamp<i32>((score - eval) * depth / 8, -MAX_CORRHIST / 4, MAX_CORRHIST / 4);
         pawnCorrhist[b.stm][b.pawnHash % CORRHIST_SIZE].update(bonus);
@@ -77,13 +175,67 @@ struct ThreadData {
         correction += pawnCorrhist[b.stm][b.pawnHash % CORRHIST_SIZE] * PAWN_CORRHIST_WEIGHT;
         correction += majorCorrhist[b.stm][b.majorHash % CORRHIST_SIZE] * MAJOR_CORRHIST_WEIGHT;
 
-        return std::clamp<i16>(staticEval + correction / 512, MATED_IN_MAX_PLY, MATE_IN_MAX_PLY);
+        return std::clamp<i16>(staticEval + correction / 512, TB_LOSS_IN_MAX_PLY + 1, TB_WIN_IN_MAX_PLY - 1);
+    }
+
+    // TT entry of a key, private to this epoch in deterministic mode
+    Transposition& getTTEntry(TranspositionTable& tt, const u64 key) {
+        if (ttOverlay.empty())
+            return tt.getEntry(key);
+
+        OverlayEntry& slot = ttOverlay[key % ttOverlay.size()];
+        if (slot.epoch != epoch || slot.entry.key != key) {
+            slot.entry = tt.getEntry(key);
+            slot.epoch = epoch;
+        }
+        return slot.entry;
+    }
+    void storeTTEntry(Transposition& slot, const Transposition& entry) {
+        slot = entry;
+        if (!ttOverlay.empty())
+            ttLog.push_back(entry);
+    }
+
+    // In deterministic mode other threads' stops are only seen at the epoch barrier
+    bool stopRequested() const {
+        if (epochBarrier != nullptr)
+            return selfStopped || epochStopped;
+        return breakFlag.load(std::memory_order_relaxed);
+    }
+    void requestStop() {
+        selfStopped = true;
+        breakFlag.store(true, std::memory_order_relaxed);
+    }
+    // Wait for every thread to reach the end of the epoch
+    void syncEpoch() {
+        epochBarrier->arrive_and_wait();
+        nextEpoch = nodes.load(std::memory_order_relaxed) + DETERMINISTIC_EPOCH_NODES;
     }
 
+    // Start loading what the child of a move will read, early enough to overlap with pruning
+    void prefetch(const Board& board, Move m) const;
+    // Only the network weights, for qsearch children that skip correction history
+    void prefetchNetwork(const Board& board, Move m) const;
+
     std::pair<Board, ThreadStackManager> makeMove(const Board& board, Move m);
     std::pair<Board, ThreadStackManager> makeNullMove(const Board& board);
 
-    // Reset the accumulator stack for a given position
+    // Pin the networks, the accumulators must be refreshed before the next evaluation
+    void setNetwork(std::shared_ptr<const Network> network, std::shared_ptr<const Network> smallNetwork = nullptr);
+
+    // Push a child made by the given update, its accumulators are written once they are needed
+    void pushAccumulators(const AccumulatorUpdate& update);
+    void popAccumulators();
+
+    // Lopsided positions use the small network when one is loaded
+    bool useSmallNetwork(const Board& b) const;
+
+    // Static eval of the position at the top of the accumulator stacks, through the eval cache
+    i16 evaluate(const Board& b);
+    // Same as evaluate, for leaves that are unlikely to be searched further
+    i16 evaluateLeaf(const Board& b);
+
+    // Reset the accumulator stacks for a given position
     void refresh(const Board& b);
     // Reset data that lasts between searches
     void reset();
@@ -98,6 +250,6 @@ struct ThreadStackManager {
     ThreadStackManager(const ThreadStackManager& other) = delete;
 
     ~ThreadStackManager() {
-        thisThread.accumulatorStack.pop();
+        thisThread.popAccumulators();
     }
 };
\ No newline at end of file
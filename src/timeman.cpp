@@ -0,0 +1,65 @@
+#include "timeman.h"
+#include "config.h"
+#include "tunable.h"
+
+#include <algorithm>
+
+// Soft time multipliers by the number of iterations the best move has held
+constexpr array<double, 6> STABILITY_SCALES = { 2.0, 1.35, 1.1, 0.9, 0.8, 0.75 };
+
+TimeManager::TimeManager(const SearchParams& sp, const Color stm) {
+    const i64 time = stm == WHITE ? sp.wtime : sp.btime;
+    const i64 inc  = stm == WHITE ? sp.winc : sp.binc;
+
+    softNodes = sp.softNodes;
+
+    if (sp.mtime) {
+        hardTime     = sp.mtime;
+        baseSoftTime = 0;
+        return;
+    }
+    if (time == 0 && inc == 0) {
+        hardTime     = 0;
+        baseSoftTime = 0;
+        return;
+    }
+
+    // Repeating time controls refill the clock after movestogo moves
+    const i64 movesToGo = sp.movesToGo ? std::min<i64>(sp.movesToGo, MAX_MOVES_TO_GO) * 1024 : DEFAULT_MOVES_TO_GO;
+    const i64 baseTime  = time * 1024 / movesToGo + inc * 1024 / INC_DIVISOR;
+
+    const i64 maxTime = std::max<i64>(time * MAX_TIME_FRACTION / 1024 - static_cast<i64>(MOVE_OVERHEAD), 1);
+
+    hardTime     = std::clamp<i64>(baseTime * HARD_TIME_SCALAR / 1024 - static_cast<i64>(MOVE_OVERHEAD), 1, maxTime);
+    baseSoftTime = std::min<i64>(baseTime * SOFT_TIME_SCALAR / 1024, hardTime);
+}
+
+void TimeManager::update(const usize depth, const Move bestMove, const i16 score, const u64 bestMoveNodes, const u64 totalNodes) {
+    stability        = bestMove == previousBestMove ? std::min(stability + 1, STABILITY_SCALES.size() - 1) : 0;
+    previousBestMove = bestMove;
+
+    const i16 scoreDrop = previousScore - score;
+    previousScore       = score;
+
+    // Shallow iterations say little about how hard the position is
+    if (depth < TM_MIN_DEPTH || totalNodes == 0) {
+        scale = 1.0;
+        return;
+    }
+
+    // Time is worth less when the best move takes nearly all nodes, and more when alternatives keep it busy
+    const double bestMoveFraction = static_cast<double>(bestMoveNodes) / totalNodes;
+    const double nodeScale        = (NODE_TM_BASE / 1024.0 - bestMoveFraction) * NODE_TM_SCALAR / 1024.0;
+
+    // A falling score asks for time to find a way out
+    const double scoreScale = isDecisive(score) ? 1.0 : std::clamp(1.0 + scoreDrop * SCORE_TREND_SCALAR / 1024.0, 0.8, 1.6);
+
+    scale = nodeScale * STABILITY_SCALES[stability] * scoreScale;
+}
+
+bool TimeManager::stopSoft(const u64 elapsedMs, const u64 nodes) const {
+    // The node budget is only ever shortened, helpers stop at the full budget
+    if (softNodes > 0 && nodes >= softNodes * std::min(scale, 1.0))
+        return true;
+    return baseSoftTime > 0 && static_cast<i64>(elapsedMs) >= baseSoftTime * scale;
+}
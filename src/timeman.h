@@ -0,0 +1,31 @@
+#pragma once
+
+#include "move.h"
+#include "search.h"
+#include "types.h"
+
+// Decides when the main thread stops, from the clock or, without one, from the soft node budget
+class TimeManager {
+    i64 hardTime;      // Milliseconds after which the search aborts, 0 when unlimited
+    i64 baseSoftTime;  // Milliseconds after which no new iteration starts, before scaling
+    u64 softNodes;     // Node budget used in place of the clock
+
+    // Scale of the soft limits, updated after every iteration
+    double scale = 1.0;
+
+    Move  previousBestMove = Move::null();
+    i16   previousScore    = 0;
+    usize stability        = 0;  // Iterations the best move has not changed
+
+   public:
+    TimeManager(const SearchParams& sp, Color stm);
+
+    i64 hardLimit() const {
+        return hardTime;
+    }
+
+    // Called by the main thread after each completed iteration
+    void update(usize depth, Move bestMove, i16 score, u64 bestMoveNodes, u64 totalNodes);
+
+    bool stopSoft(u64 elapsedMs, u64 nodes) const;
+};
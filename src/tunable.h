@@ -67,6 +67,9 @@ Tunable(BISHOP_VALUE, 300);
 Tunable(ROOK_VALUE, 500);
 Tunable(QUEEN_VALUE, 800);
 
+// Evaluation
+Tunable(SMALL_NET_THRESHOLD, 1200);  // Material imbalance above which the small network is used
+
 // Move ordering
 Tunable(MO_VICTIM_SCALAR, 100);
 Tunable(MO_CAPTURE_SEE_THRESHOLD, 56);
@@ -83,15 +86,29 @@ Tunable(MAJOR_CORRHIST_WEIGHT, 32);
 // Time management
 Tunable(DEFAULT_MOVES_TO_GO, 19018);  // Quantized by 1024
 Tunable(INC_DIVISOR, 2156);           // Quantized by 1024
+Tunable(SOFT_TIME_SCALAR, 614);       // Quantized by 1024
+Tunable(HARD_TIME_SCALAR, 2048);      // Quantized by 1024
+Tunable(MAX_TIME_FRACTION, 768);      // Quantized by 1024, of the remaining time
+Tunable(NODE_TM_BASE, 1536);          // Quantized by 1024
+Tunable(NODE_TM_SCALAR, 1382);        // Quantized by 1024
+Tunable(SCORE_TREND_SCALAR, 20);      // Quantized by 1024, per centipawn
+constexpr usize TM_MIN_DEPTH    = 6;
+constexpr usize MAX_MOVES_TO_GO = 50;
 
 // Aspiration windows
 constexpr i32 MIN_ASP_WINDOW_DEPTH = 5;
 Tunable(INITIAL_ASP_WINDOW, 30);
+Tunable(SMP_ASP_WINDOW_STEP, 64);    // Quantized by 1024, widening of each helper's window in a cycle of four
 Tunable(ASP_WIDENING_FACTOR, 2591);  // Quantized by 1024
 
+// Best thread vote
+Tunable(VOTE_SCORE_OFFSET, 14);
+
 // Main search
-constexpr i16 NMP_DEPTH_REDUCTION = 4;
-constexpr i32 SE_MIN_DEPTH        = 8;
+constexpr i16 NMP_DEPTH_REDUCTION    = 4;
+constexpr i32 SE_MIN_DEPTH           = 8;
+constexpr int LMP_MAX_DEPTH          = 8;
+constexpr i32 HIST_PRUNING_MAX_DEPTH = 4;
 
 Tunable(RFP_DEPTH_SCALAR, 66);
 
@@ -103,10 +120,16 @@ Tunable(LMR_NOISY_CONST, 202);
 Tunable(LMR_QUIET_DIVISOR, 2835);
 Tunable(LMR_NOISY_DIVISOR, 3319);
 Tunable(LMR_NONPV, 1046);
+Tunable(LMR_KILLER, 1024);
+Tunable(LMR_HISTORY_DIVISOR, 16384);  // History that changes the reduction by one ply
+Tunable(SMP_LMR_OFFSET, 128);         // Quantized by 1024, only used by helper threads with LMR perturbation
 
 Tunable(FUTILITY_PRUNING_MARGIN, 100);
 Tunable(FUTILITY_PRUNING_SCALAR, 78);
 
+Tunable(LMP_BASE, 3);
+Tunable(HIST_PRUNING_SCALAR, 2048);
+
 Tunable(SEE_QUIET_SCALAR, 25);
 Tunable(SEE_NOISY_SCALAR, 90);
 
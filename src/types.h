@@ -15,6 +15,7 @@ using u8  = uint8_t;
 using i64 = int64_t;
 using i32 = int32_t;
 using i16 = int16_t;
+using i8  = int8_t;
 
 #ifdef _MSC_VER
     #include <__msvc_int128.hpp>
@@ -159,37 +160,6 @@ public:
     }
 };
 
-template<typename Type, usize size>
-class Stack {
-    array<Type, size> underlying;
-    usize ptr;
-
-  public:
-      Stack() {
-          ptr = 0;
-      }
-
-      void push(const Type& t) {
-          assert(ptr < size);
-          underlying[ptr++] = t;
-      }
-      Type pop() {
-          assert(ptr > 0);
-          return underlying[--ptr];
-      }
-      const Type& top() const {
-          assert(ptr > 0);
-          return underlying[ptr - 1];
-      }
-      Type& topAsReference() {
-          assert(ptr > 0);
-          return underlying[ptr - 1];
-      }
-      void clear() {
-          ptr = 0;
-      }
-};
-
 namespace internal {
     template <typename T, usize kN, usize... kNs>
     struct MultiArrayImpl {